@@ -0,0 +1,489 @@
+// 流水线各阶段的基准测试：OBJ 解析、骨架 JSON 解析、权重计算、骨骼矩阵、CPU 蒙皮、三角形 BVH 和帧编码。
+// 网格规模和骨骼数可以各给一组取值，每种组合都生成一个合成角色；每项先预热再重复测量，
+// 报告中位数和分位数，并可输出 JSON，用于跨提交追踪性能回退。不需要 OpenGL 上下文
+#include "Mesh.h"
+#include "Skeleton.h"
+#include "HeatSkinning.h"
+#include "VoxelSkinning.h"
+#include "WeightSmoothing.h"
+#include "CpuSkinning.h"
+#include "ColorConvert.h"
+#include "FrameWriter.h"
+#include "Y4MWriter.h"
+#include "Parallel.h"
+#include "RigGenerator.h"
+#include "TriangleBVH.h"
+#include "json.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// 命令行参数
+struct BenchOptions
+{
+    std::vector<size_t> vertices = {10000, 100000}; // 合成角色的目标顶点数（OBJ 加载后的面角顶点数）
+    std::vector<size_t> bones = {32, 160};          // 骨骼数
+    int warmup = 2;                                  // 预热次数，不计入结果
+    int reps = 10;                                   // 测量次数
+    int voxelResolution = 64;                        // 体素绑定的分辨率
+    int frameWidth = 1920, frameHeight = 1080;       // 帧编码的分辨率
+    std::string filter;                              // 只运行名字包含该子串的项
+    std::string json;                                // JSON 结果输出路径，"-" 表示标准输出
+    std::string label;                               // 写入 JSON 的标签，例如提交号
+    std::string tempDir = "bench_tmp";               // 合成资源和编码输出的临时目录
+};
+
+// 一项测量的结果。samples 为每次测量的毫秒数（已除以批量次数）
+struct BenchResult
+{
+    std::string name;
+    size_t vertices;
+    size_t bones;
+    double items; // 每次处理的元素数（顶点、骨骼或像素），用于计算吞吐量
+    std::vector<double> samples;
+};
+
+// 在测量函数中圈出计时区间，区间外的准备工作不计时
+class Stopwatch
+{
+public:
+    void start() { begin = std::chrono::steady_clock::now(); }
+    void stop() { elapsed += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(); }
+    double milliseconds() const { return elapsed; }
+    void reset() { elapsed = 0.0; }
+
+private:
+    std::chrono::steady_clock::time_point begin;
+    double elapsed = 0.0;
+};
+
+static std::vector<size_t> parseList(const std::string &text)
+{
+    std::vector<size_t> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+            values.push_back((size_t)std::max(1LL, std::atoll(item.c_str())));
+    }
+    return values;
+}
+
+static BenchOptions parseOptions(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--vertices" && i + 1 < argc)
+            options.vertices = parseList(argv[++i]);
+        else if (arg == "--bones" && i + 1 < argc)
+            options.bones = parseList(argv[++i]);
+        else if (arg == "--warmup" && i + 1 < argc)
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--reps" && i + 1 < argc)
+            options.reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--voxel-res" && i + 1 < argc)
+            options.voxelResolution = std::max(8, std::atoi(argv[++i]));
+        else if (arg == "--frame" && i + 1 < argc)
+        {
+            int w = 0, h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 1 && h > 1)
+            {
+                options.frameWidth = w & ~1;
+                options.frameHeight = h & ~1;
+            }
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+            options.filter = argv[++i];
+        else if (arg == "--json" && i + 1 < argc)
+            options.json = argv[++i];
+        else if (arg == "--label" && i + 1 < argc)
+            options.label = argv[++i];
+        else if (arg == "--temp-dir" && i + 1 < argc)
+            options.tempDir = argv[++i];
+        else
+            std::cerr << "Unknown argument: " << arg << std::endl;
+    }
+    return options;
+}
+
+// 线性插值的分位数，sorted 已升序
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    double pos = p * (sorted.size() - 1);
+    size_t lo = (size_t)pos;
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (pos - lo);
+}
+
+// --- 合成角色（RigGenerator，与 RigGen 工具相同） ---
+
+// 每个骨骼绕局部 x 轴弯一点，得到一个确定的非静止姿态
+static void poseSkeleton(Skeleton &skeleton, float time)
+{
+    for (size_t i = 0; i < skeleton.bones.size(); i++)
+    {
+        Bone &b = skeleton.bones[i];
+        b.poseMatrix = b.restMatrix * glm::rotate(glm::mat4(1.0f), 0.3f * std::sin(time + i * 0.1f), glm::vec3(1, 0, 0));
+    }
+}
+
+// --- 测量 ---
+
+class BenchRunner
+{
+public:
+    explicit BenchRunner(const BenchOptions &options) : options(options) {}
+
+    // fn(stopwatch) 执行一次，需要计时的部分放在 start / stop 之间；batch 为 fn 内部重复的次数
+    void run(const std::string &name, size_t vertices, size_t bones, double items,
+             const std::function<void(Stopwatch &)> &fn, int batch = 1)
+    {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+            return;
+
+        BenchResult result = {name, vertices, bones, items, {}};
+        Stopwatch watch;
+        for (int i = 0; i < options.warmup + options.reps; i++)
+        {
+            watch.reset();
+            fn(watch);
+            if (i >= options.warmup)
+                result.samples.push_back(watch.milliseconds() / batch);
+        }
+        print(result);
+        results.push_back(std::move(result));
+    }
+
+    bool writeJSON() const
+    {
+        if (options.json.empty())
+            return true;
+
+        json out;
+        out["label"] = options.label;
+        out["threads"] = parallelThreadCount();
+        out["avx2"] = CpuSkinning::hasAVX2();
+        out["warmup"] = options.warmup;
+        out["reps"] = options.reps;
+        out["results"] = json::array();
+        for (const BenchResult &r : results)
+        {
+            std::vector<double> sorted = r.samples;
+            std::sort(sorted.begin(), sorted.end());
+            double mean = 0.0;
+            for (double s : sorted)
+                mean += s;
+            mean /= sorted.size();
+            double median = percentile(sorted, 0.5);
+            out["results"].push_back({{"name", r.name},
+                                      {"vertices", r.vertices},
+                                      {"bones", r.bones},
+                                      {"min_ms", sorted.front()},
+                                      {"mean_ms", mean},
+                                      {"p50_ms", median},
+                                      {"p90_ms", percentile(sorted, 0.9)},
+                                      {"p99_ms", percentile(sorted, 0.99)},
+                                      {"max_ms", sorted.back()},
+                                      {"items_per_second", median > 0.0 ? r.items / (median / 1000.0) : 0.0},
+                                      {"samples_ms", r.samples}});
+        }
+
+        if (options.json == "-")
+        {
+            std::cout << out.dump(2) << std::endl;
+            return true;
+        }
+        std::ofstream file(options.json);
+        if (!file)
+        {
+            std::cerr << "Failed to write " << options.json << std::endl;
+            return false;
+        }
+        file << out.dump(2) << std::endl;
+        std::cerr << "Results written to " << options.json << std::endl;
+        return (bool)file;
+    }
+
+private:
+    void print(const BenchResult &r) const
+    {
+        std::vector<double> sorted = r.samples;
+        std::sort(sorted.begin(), sorted.end());
+        double median = percentile(sorted, 0.5);
+        // 结果表写到标准错误，标准输出留给 --json -
+        std::cerr << std::left << std::setw(22) << r.name << std::right
+                  << std::setw(9) << r.vertices << " v" << std::setw(6) << r.bones << " b"
+                  << std::fixed << std::setprecision(3)
+                  << "  p50 " << std::setw(10) << median << " ms"
+                  << "  p90 " << std::setw(10) << percentile(sorted, 0.9) << " ms"
+                  << "  min " << std::setw(10) << sorted.front() << " ms"
+                  << std::defaultfloat << std::setprecision(4)
+                  << "  " << (median > 0.0 ? r.items / (median / 1000.0) / 1e6 : 0.0) << " M/s" << std::endl;
+    }
+
+    const BenchOptions &options;
+    std::vector<BenchResult> results;
+};
+
+// 网格相关的各阶段：解析、权重、骨骼矩阵、蒙皮
+static bool benchRig(BenchRunner &runner, const BenchOptions &options, size_t vertexCount, size_t boneCount)
+{
+    const std::string objPath = options.tempDir + "/rig.obj";
+    const std::string skeletonPath = options.tempDir + "/rig.json";
+    RigGenerator generator;
+    if (!generator.generate(RigParams::forBoneCount(boneCount, vertexCount)) ||
+        !generator.writeOBJ(objPath) || !generator.writeSkeleton(skeletonPath))
+        return false;
+
+    Mesh mesh;
+    Skeleton skeleton;
+    if (!mesh.loadOBJ(objPath) || !skeleton.loadFromJSON(skeletonPath))
+        return false;
+    const size_t v = mesh.vertices.size(), b = skeleton.bones.size();
+
+    runner.run("obj_parse", v, b, (double)v, [&](Stopwatch &w)
+               {
+                   Mesh m;
+                   w.start();
+                   m.loadOBJ(objPath);
+                   w.stop();
+               });
+
+    runner.run("skeleton_parse", v, b, (double)b, [&](Stopwatch &w)
+               {
+                   Skeleton s;
+                   w.start();
+                   s.loadFromJSON(skeletonPath);
+                   w.stop();
+               });
+
+    // HeatSkinning 按原角色的骨骼序号挑选躯干和腿部骨骼，合成骨架不适用
+    if (HeatSkinning::supports(skeleton))
+    {
+        runner.run("weights_heat", v, b, (double)v, [&](Stopwatch &w)
+                   {
+                       Mesh m = mesh;
+                       w.start();
+                       HeatSkinning::computeWeights(m, skeleton);
+                       w.stop();
+                   });
+    }
+
+    runner.run("weights_voxel", v, b, (double)v, [&](Stopwatch &w)
+               {
+                   Mesh m = mesh;
+                   w.start();
+                   VoxelSkinning::computeWeights(m, skeleton, options.voxelResolution);
+                   w.stop();
+               });
+
+    // 之后的阶段都使用体素权重
+    VoxelSkinning::computeWeights(mesh, skeleton, options.voxelResolution);
+    mesh.sortByInfluenceCount();
+
+    runner.run("weights_smooth", v, b, (double)v, [&](Stopwatch &w)
+               {
+                   Mesh m = mesh;
+                   w.start();
+                   WeightSmoothing::smooth(m, 4);
+                   w.stop();
+               });
+
+    // 骨骼矩阵一次只有几微秒，每次测量重复多次再平均
+    const int paletteBatch = 200;
+    std::vector<glm::mat4> palette(b);
+    Skeleton pose = skeleton;
+    runner.run("bone_palette", v, b, (double)b, [&](Stopwatch &w)
+               {
+                   w.start();
+                   for (int i = 0; i < paletteBatch; i++)
+                   {
+                       poseSkeleton(pose, i * 0.01f);
+                       pose.computeBoneMatrices(palette.data());
+                   }
+                   w.stop();
+               },
+               paletteBatch);
+
+    poseSkeleton(pose, 1.0f);
+    pose.computeBoneMatrices(palette.data());
+    CpuSkinning skinning;
+    skinning.prepare(mesh);
+    SkinnedVertices out;
+
+    const CpuSkinning::Mode modes[] = {CpuSkinning::Mode::Linear, CpuSkinning::Mode::DualQuaternion};
+    for (CpuSkinning::Mode mode : modes)
+    {
+        for (int simd = 1; simd >= 0; simd--)
+        {
+            if (simd && !CpuSkinning::hasAVX2())
+                continue;
+            skinning.setUseAVX2(simd != 0);
+            std::string name = mode == CpuSkinning::Mode::Linear ? "skin_lbs" : "skin_dqs";
+            if (!simd)
+                name += "_scalar";
+            runner.run(name, v, b, (double)v, [&](Stopwatch &w)
+                       {
+                           w.start();
+                           skinning.skin(palette.data(), palette.size(), mode, out);
+                           w.stop();
+                       });
+        }
+    }
+
+    // 三角形 BVH：静止姿态上构建，refit 到蒙皮后的姿态，再在该姿态上做射线查询
+    const double triangles = (double)(mesh.indices.size() / 3);
+    skinning.setUseAVX2(true);
+    skinning.skin(palette.data(), palette.size(), CpuSkinning::Mode::Linear, out);
+    TriangleBVH bvh;
+    runner.run("bvh_build", v, b, triangles, [&](Stopwatch &w)
+               {
+                   w.start();
+                   bvh.build(mesh);
+                   w.stop();
+               });
+
+    bvh.setRebuildRatio(1e30f); // 只测 refit，不触发重建
+    runner.run("bvh_refit", v, b, triangles, [&](Stopwatch &w)
+               {
+                   w.start();
+                   bvh.refit(out);
+                   w.stop();
+               });
+
+    // 从包围盒外围射向角色的固定一组射线
+    const int rayCount = 10000;
+    const BoundingBox box = bvh.bounds();
+    const glm::vec3 center = (box.min + box.max) * 0.5f, extent = box.max - box.min;
+    std::vector<Ray> rays(rayCount);
+    for (int i = 0; i < rayCount; i++)
+    {
+        float a = i * 2.399963f, y = (i + 0.5f) / rayCount - 0.5f; // 黄金角螺旋
+        glm::vec3 origin = center + glm::vec3(std::cos(a), y, std::sin(a)) * extent;
+        rays[i] = {origin, center + glm::vec3(0.0f, y, 0.0f) * extent - origin};
+    }
+    runner.run("bvh_raycast", v, b, (double)rayCount, [&](Stopwatch &w)
+               {
+                   RayHit hit;
+                   w.start();
+                   for (const Ray &ray : rays)
+                       bvh.raycast(ray, 1.0f, hit);
+                   w.stop();
+               });
+    return true;
+}
+
+// 帧编码：与网格无关，只跑一次
+static void benchEncoding(BenchRunner &runner, const BenchOptions &options)
+{
+    const int w = options.frameWidth, h = options.frameHeight;
+    const double pixels = (double)w * h;
+
+    // 带渐变和噪声的测试帧，避免 PNG 压缩过于理想
+    std::vector<unsigned char> rgba((size_t)w * h * 4), rgb((size_t)w * h * 3);
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < (size_t)w * h; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        int x = (int)(i % w), y = (int)(i / w);
+        unsigned char noise = (unsigned char)(seed >> 28);
+        unsigned char c[3] = {(unsigned char)(x * 255 / w + noise), (unsigned char)(y * 255 / h), (unsigned char)(128 + noise)};
+        for (int k = 0; k < 3; k++)
+        {
+            rgba[i * 4 + k] = c[k];
+            rgb[i * 3 + k] = c[k];
+        }
+        rgba[i * 4 + 3] = 255;
+    }
+
+    std::vector<unsigned char> yPlane((size_t)w * h), uPlane((size_t)w * h / 4), vPlane((size_t)w * h / 4);
+    runner.run("convert_yuv420", 0, 0, pixels, [&](Stopwatch &sw)
+               {
+                   sw.start();
+                   rgbaToYuv420(rgba.data(), w, h, yPlane.data(), uPlane.data(), vPlane.data());
+                   sw.stop();
+               });
+    runner.run("convert_yuv420_scalar", 0, 0, pixels, [&](Stopwatch &sw)
+               {
+                   sw.start();
+                   rgbaToYuv420Scalar(rgba.data(), w, h, yPlane.data(), uPlane.data(), vPlane.data());
+                   sw.stop();
+               });
+
+    // 编码并写盘，缓冲池只有一帧，测的是一帧从提交到写完的时间
+    const FrameWriter::Format formats[] = {FrameWriter::Format::PPM, FrameWriter::Format::PNG};
+    for (FrameWriter::Format format : formats)
+    {
+        FrameWriter writer(options.tempDir, format, w, h, 1);
+        runner.run(format == FrameWriter::Format::PNG ? "encode_png" : "encode_ppm", 0, 0, pixels, [&](Stopwatch &sw)
+                   {
+                       sw.start();
+                       writer.writeFrame(0, rgb.data());
+                       writer.finish();
+                       sw.stop();
+                   });
+        std::remove(writer.filename(0).c_str());
+    }
+
+    Y4MWriter y4m(options.tempDir + "/bench.y4m", w, h, 30);
+    if (y4m.open())
+    {
+        int frame = 0;
+        runner.run("encode_y4m", 0, 0, pixels, [&](Stopwatch &sw)
+                   {
+                       sw.start();
+                       y4m.writeFrame(frame++, rgba.data());
+                       sw.stop();
+                   });
+        y4m.finish();
+    }
+    std::remove((options.tempDir + "/bench.y4m").c_str());
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = parseOptions(argc, argv);
+
+#ifdef _WIN32
+    system(("if not exist " + options.tempDir + " mkdir " + options.tempDir).c_str());
+#else
+    system(("mkdir -p '" + options.tempDir + "'").c_str());
+#endif
+
+    std::cerr << "SkinningBench: " << parallelThreadCount() << " threads, AVX2 "
+              << (CpuSkinning::hasAVX2() ? "available" : "not available") << ", " << options.warmup
+              << " warmup + " << options.reps << " reps" << std::endl;
+
+    BenchRunner runner(options);
+    for (size_t vertices : options.vertices)
+    {
+        for (size_t bones : options.bones)
+        {
+            if (!benchRig(runner, options, vertices, bones))
+                return 1;
+        }
+    }
+    benchEncoding(runner, options);
+
+    std::remove((options.tempDir + "/rig.obj").c_str());
+    std::remove((options.tempDir + "/rig.json").c_str());
+    return runner.writeJSON() ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// 线性（单调）内存池：只能分配不能单独释放，用完后整体释放。
+// 用于加载阶段的临时数据（文件内容、解析出的中间数组、名称表），
+// 分配只是移动指针，释放是一次性归还所有内存块，不会在堆上留下碎片
+class Arena
+{
+public:
+    // blockSize: 每次向系统申请的内存块大小，超过它的分配单独占一块
+    explicit Arena(size_t blockSize = 1 << 20);
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // 未初始化的数组，只能放不需要析构的类型
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena does not run destructors");
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // 把字符串复制进内存池，返回的视图在 release 之前有效
+    std::string_view copyString(std::string_view text);
+
+    // 归还所有内存块，之前分配的指针全部失效
+    void release();
+
+    size_t bytesUsed() const { return used; }         // 已分配出去的字节数
+    size_t bytesReserved() const { return reserved; } // 向系统申请的字节数
+
+private:
+    std::vector<char *> blocks;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+    size_t blockSize;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+// 让标准容器从 Arena 分配；deallocate 不做任何事，内存随 Arena 一起释放
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    Arena *arena;
+};
@@ -9,5 +9,6 @@ struct Bone
     glm::mat4 restMatrix;    // 静止姿态矩阵
     glm::mat4 invRestMatrix; // 静止姿态逆矩阵
     glm::mat4 poseMatrix;    // 当前动画姿态
+    glm::vec3 tail;          // 静止姿态下骨骼尾部位置
     std::string name;
 };
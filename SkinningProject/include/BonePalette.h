@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// 骨骼矩阵调色板：放在纹理缓冲（TBO）里，着色器用 texelFetch 读取，没有骨骼数量上限。
+// 缓冲分成 REGIONS 个区域轮流使用（三重缓冲），CPU 直接写入映射内存，
+// 每帧绘制后插入 fence，再次使用同一区域前等待 GPU 读完
+class BonePalette
+{
+public:
+    static const int REGIONS = 3;
+
+    BonePalette();
+    ~BonePalette();
+
+    // capacity: 每帧最多写入的矩阵数量
+    bool create(size_t capacity);
+    void destroy();
+
+    // 等待当前区域空闲并映射，返回可写入 capacity 个矩阵的指针（只写，不要读取）
+    glm::mat4 *map();
+    void unmap();
+    // 本帧的绘制命令提交后调用：插入 fence 并切换到下一个区域
+    void fence();
+
+    void bind(int unit) const;
+    // 当前区域第一个矩阵在纹理缓冲中的序号，传给着色器的 uPaletteBase
+    int base() const { return (int)(region * matrices); }
+    size_t capacity() const { return matrices; }
+
+private:
+    unsigned int buffer;
+    unsigned int texture;
+    size_t matrices;
+    int region;
+    void *fences[REGIONS]; // GLsync
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// RGBA（自上而下，每像素 4 字节）转 YUV 4:2:0 平面格式，BT.709 有限范围（Y 16-235，UV 16-240）。
+// 色度取 2x2 块的平均值（中心对齐，对应 Y4M 的 C420jpeg）。
+// x86 上使用 SSE2 一次处理 16 个亮度 / 4 个色度样本，其余平台和尾部使用相同定点公式的标量实现
+void rgbaToYuv420(const unsigned char *rgba, int width, int height,
+                  unsigned char *y, unsigned char *u, unsigned char *v);
+
+// 标量参考实现，结果与 rgbaToYuv420 逐字节相同
+void rgbaToYuv420Scalar(const unsigned char *rgba, int width, int height,
+                        unsigned char *y, unsigned char *u, unsigned char *v);
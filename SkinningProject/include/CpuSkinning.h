@@ -0,0 +1,63 @@
+#pragma once
+#include "Mesh.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// CPU 蒙皮结果（SoA）。数组长度补齐到 8 的倍数，只有前 count 个有效
+struct SkinnedVertices
+{
+    size_t count = 0;
+    std::vector<float> px, py, pz;
+    std::vector<float> nx, ny, nz;
+
+    glm::vec3 position(size_t i) const { return glm::vec3(px[i], py[i], pz[i]); }
+    glm::vec3 normal(size_t i) const { return glm::vec3(nx[i], ny[i], nz[i]); }
+};
+
+// CPU 蒙皮：与 skinning.vert 相同的变形，用于导出、碰撞和校验。
+// 顶点数据在 prepare 时转成 SoA，蒙皮按 8 个顶点一组并行处理；
+// 支持 AVX2 的 x86 CPU 上运行时选择 AVX2 + FMA 内核，否则使用标量内核
+class CpuSkinning
+{
+public:
+    enum class Mode
+    {
+        Linear,        // 线性混合（LBS），与着色器一致
+        DualQuaternion // 对偶四元数（DQS），关节处不塌陷；要求骨骼矩阵为刚体变换
+    };
+
+    CpuSkinning();
+
+    // 拷贝网格的静止姿态和蒙皮权重（SoA）。没有权重的顶点保持不动
+    void prepare(const Mesh &mesh);
+
+    // 用 boneCount 个骨骼矩阵（Skeleton::computeBoneMatrices 的输出）变形所有顶点
+    void skin(const glm::mat4 *palette, size_t boneCount, Mode mode, SkinnedVertices &out);
+
+    size_t vertexCount() const { return count; }
+
+    // CPU 是否支持 AVX2 + FMA
+    static bool hasAVX2();
+    // 强制使用标量内核（用于基准测试和校验）
+    void setUseAVX2(bool enable) { useAVX2 = enable && hasAVX2(); }
+    bool usingAVX2() const { return useAVX2; }
+
+private:
+    void uploadPalette(const glm::mat4 *palette, size_t boneCount, Mode mode);
+
+    size_t count;  // 有效顶点数
+    size_t padded; // 补齐到 8 的倍数
+    bool useAVX2;
+
+    // 静止姿态
+    std::vector<float> px, py, pz, nx, ny, nz;
+    // 每个影响槽一组数组：ids[k][i]、weights[k][i]；ids 是调色板下标（骨骼序号 + 1）
+    std::vector<int> ids[4];
+    std::vector<float> weights[4];
+
+    // 调色板：第 0 项是单位变换，供没有权重的顶点和补齐的顶点使用
+    std::vector<float> affine; // 每个骨骼 12 个浮点：3x4 矩阵按行存放
+    std::vector<float> dualQuats; // 每个骨骼 8 个浮点：实部 xyzw，对偶部 xyzw
+
+    size_t recordedOutput = 0; // 上次登记给 MemoryStats 的输出大小，变化时才重新登记
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+// 异步帧读回：ringSize 个 PBO 轮流使用。第 k 帧的 glReadPixels 写入 PBO 并插入 fence，
+// 在第 k+1..k+N 帧渲染期间由 GPU 完成拷贝，CPU 只在最旧的 fence 完成后才映射它
+class FrameReadback
+{
+public:
+    // pixels 为自上而下的 RGB / RGBA 数据（渲染时投影已上下翻转），直接指向映射的 PBO，只在回调期间有效
+    using Callback = std::function<void(int frame, const unsigned char *pixels)>;
+
+    FrameReadback();
+    ~FrameReadback();
+
+    // channels: 3 读回 RGB，4 读回 RGBA
+    bool create(int width, int height, int ringSize, int channels = 3);
+    void destroy();
+
+    // 当前帧渲染完后调用：发起读回；ring 已满时先完成（必要时等待）最旧的一帧
+    void readFrame(int frame, const Callback &onReady);
+    // 完成所有 fence 已经完成的帧，不阻塞
+    void poll(const Callback &onReady);
+    // 完成所有未完成的帧
+    void flush(const Callback &onReady);
+
+    size_t frameBytes() const { return (size_t)width * height * channels; }
+
+private:
+    struct Slot
+    {
+        unsigned int pbo = 0;
+        void *fence = nullptr; // GLsync
+        int frame = -1;
+    };
+
+    bool complete(Slot &slot, bool wait, const Callback &onReady);
+
+    int width, height, channels;
+    std::vector<Slot> slots;
+    size_t next;   // 下一次读回使用的槽
+    size_t oldest; // 最旧的未完成槽
+    size_t pending;
+};
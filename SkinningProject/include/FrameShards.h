@@ -0,0 +1,28 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+// 一段连续的帧 [begin, end)
+struct FrameRange
+{
+    int begin;
+    int end;
+};
+
+// 按帧区间分片并行渲染：每一帧只依赖 time = frame / FPS，不同区间互不相关。
+// 每个分片在 fork 出的子进程中渲染，子进程创建自己的 OpenGL 上下文；
+// 已加载的网格、骨架和权重通过 fork 的写时复制页面共享，不需要重新加载或计算
+class FrameShards
+{
+public:
+    // 把 [0, totalFrames) 尽量均匀地切成 shards 段（多余的帧分给前面的分片）
+    static std::vector<FrameRange> split(int totalFrames, int shards);
+
+    // 当前平台是否支持多进程分片（需要 fork，仅 Linux / POSIX）
+    static bool isSupported();
+
+    // 为每个区间 fork 一个子进程执行 worker(shard, range)，worker 的返回值作为子进程的退出码。
+    // 必须在创建任何 OpenGL 上下文和后台线程之前调用。返回失败的分片数
+    static int run(const std::vector<FrameRange> &ranges,
+                   const std::function<int(int shard, const FrameRange &range)> &worker);
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// 帧输出目标：接收读回的帧（自上而下，channels() 个 8 位通道），负责编码和写出
+class FrameSink
+{
+public:
+    virtual ~FrameSink() = default;
+
+    // 希望读回的通道数（3 = RGB，4 = RGBA）
+    virtual int channels() const { return 3; }
+
+    // pixels 只在调用期间有效（通常指向映射的 PBO），实现需要自行拷贝或在返回前处理完
+    virtual void writeFrame(int frame, const unsigned char *pixels) = 0;
+
+    // 等待所有已提交的帧写完
+    virtual void finish() {}
+
+    // 输出文件的提示信息（用于结束时打印转换命令）
+    virtual const char *describe() const = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include "FrameSink.h"
+#include "TaskScheduler.h"
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 图像序列输出：有界缓冲池 + 调度器任务。渲染线程只把像素拷进缓冲池中的一块缓冲、提交一个编码任务就返回，
+// 编码（PNG 压缩）和写盘由 TaskScheduler 的工作线程并行完成；缓冲池用完时 writeFrame 等待最早的一帧写完
+// （等待期间帮忙执行任务），内存始终有上限
+class FrameWriter : public FrameSink
+{
+public:
+    enum class Format
+    {
+        PPM, // 无压缩
+        PNG  // 无损压缩（stb_image_write）
+    };
+
+    // maxQueued: 最多同时在队列中或正在编码的帧数
+    FrameWriter(const std::string &directory, Format format, int width, int height, int maxQueued);
+    ~FrameWriter() override;
+
+    void writeFrame(int frame, const unsigned char *pixels) override;
+    void finish() override;
+    const char *describe() const override;
+
+    std::string filename(int frame) const;
+
+private:
+    void encode(int frame, const std::vector<unsigned char> &pixels) const;
+
+    std::string directory;
+    std::string pattern; // describe() 返回的文件名模式，例如 output/frame_%05d.ppm
+    Format format;
+    int width, height;
+
+    std::mutex mutex; // 保护 freeBuffers，编码任务写完后把缓冲还回来
+    std::vector<std::vector<unsigned char>> freeBuffers;
+    std::deque<TaskRef> pending; // 已提交的编码任务，按帧顺序；只有渲染线程访问
+};
@@ -2,9 +2,13 @@
 #include "Mesh.h"
 #include "Skeleton.h"
 
+// 热扩散绑定：按原角色的骨骼序号（147-158 为骨盆、腿和脚）挑选躯干和腿部骨骼
 class HeatSkinning
 {
 public:
+    // 骨架是否是原角色的骨架：147-158 号骨骼的名称与原角色一致
+    static bool supports(const Skeleton &skeleton);
+
     static void computeWeights(
         Mesh &mesh,
         const Skeleton &skeleton);
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// CPU 内存的分类
+enum class MemoryCategory
+{
+    MeshVertices, // 顶点位置和法线
+    MeshIndices,
+    Weights,      // 每个顶点的骨骼索引和权重
+    Skeleton,     // 静止姿态的骨骼
+    Animation,    // 人群实例和逐帧姿态
+    FrameBuffers, // 输出帧的缓冲（写出缓冲池、软件渲染的帧缓冲）
+    Caches,       // 由其他数据派生、可以重建的数据（剔除包围盒、蒙皮中间结果、分桶）
+    Count
+};
+
+// GPU 内存的分类
+enum class GpuMemoryCategory
+{
+    VertexBuffer,
+    IndexBuffer,
+    InstanceBuffer,
+    BonePalette,
+    Framebuffer,
+    PixelBuffer, // 读回用的 PBO
+    Count
+};
+
+struct MemoryUsage
+{
+    size_t current;
+    size_t peak;
+};
+
+// 内存占用统计：各模块按名称登记自己持有的大块内存（数组、缓冲池、GPU 缓冲），
+// 大小变化时重新登记（覆盖旧值），释放时登记 0。不拦截每次分配，开销只在登记时；
+// 每帧都会走到的位置应当先和上次登记的大小比较，只在变化时登记。
+// 每一类和总量都记录峰值，用来估算一个节点能放下多少角色和并发任务
+class MemoryStats
+{
+public:
+    static void set(MemoryCategory category, const std::string &name, size_t bytes);
+    static void set(GpuMemoryCategory category, const std::string &name, size_t bytes);
+
+    static MemoryUsage usage(MemoryCategory category);
+    static MemoryUsage usage(GpuMemoryCategory category);
+    static MemoryUsage cpuTotal();
+    static MemoryUsage gpuTotal();
+
+    // 进程的常驻内存（Linux 上读取 /proc/self/status 的 VmRSS / VmHWM），不支持时为 0。
+    // 包括没有登记的部分（代码、驱动、标准库），可以和登记的总量对照
+    static MemoryUsage residentSet();
+
+    static const char *name(MemoryCategory category);
+    static const char *name(GpuMemoryCategory category);
+
+    // 按分类列出当前和峰值占用，以及每一项的明细
+    static void printReport(std::ostream &out);
+    // 一行峰值汇总
+    static void printPeak(std::ostream &out);
+
+    // 按大小选择 B / KB / MB 的可读格式
+    static std::string format(size_t bytes);
+
+    // 数组实际占用的字节数（按容量计）
+    template <typename T>
+    static size_t bytes(const std::vector<T> &v) { return v.capacity() * sizeof(T); }
+};
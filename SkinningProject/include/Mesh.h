@@ -12,6 +12,26 @@ struct Vertex
     glm::vec4 weights = glm::vec4(0.0f);
 };
 
+// 顶点邻接（CSR 格式）。OBJ 加载时每个面角都是独立顶点，
+// 这里先按位置焊接成节点，再由三角形的边建立节点之间的邻接
+struct MeshAdjacency
+{
+    std::vector<unsigned int> vertexToNode; // 顶点 -> 节点
+    std::vector<unsigned int> offsets;      // 节点 i 的邻居为 neighbors[offsets[i], offsets[i + 1])
+    std::vector<unsigned int> neighbors;
+
+    size_t nodeCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+// 一段使用同一着色器变体绘制的三角形
+struct DrawRange
+{
+    int influences;     // 着色器变体的影响骨骼数（1/2/4）
+    unsigned int first; // 在 indices 中的起始偏移
+    unsigned int count; // 索引数量
+    int partition;      // 骨骼分组（见 SkinnedBounds::partitionBones），用于按子网格剔除
+};
+
 class Mesh
 {
 public:
@@ -19,4 +39,12 @@ public:
     std::vector<unsigned int> indices;
 
     bool loadOBJ(const std::string &path);
+    MeshAdjacency buildAdjacency() const;
+    // 三角形 t 的主导骨骼：三个顶点的权重按骨骼求和后最大者，没有权重时返回 -1
+    int dominantBone(size_t t) const;
+
+    // 渲染前的预处理：把每个顶点的影响按权重降序排列，再按三角形的最大影响数
+    // （归到 1/2/4）重排 indices，返回每组对应的绘制区间。
+    // bonePartition 非空时排序键再加上三角形主导骨骼所在的分组，每个（影响数，分组）一个区间
+    std::vector<DrawRange> sortByInfluenceCount(const std::vector<int> &bonePartition = {});
 };
@@ -0,0 +1,46 @@
+#pragma once
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+
+// 工作线程数上限，0 表示不限制（按 CPU 核数）
+inline unsigned int &parallelThreadLimit()
+{
+    static unsigned int limit = 0;
+    return limit;
+}
+
+// 限制工作线程数，例如多个分片进程共享 CPU 时每个进程只用一部分核。
+// 已创建的调度器会被关闭，下次使用时按新的线程数重建
+inline void setParallelThreadCount(unsigned int count)
+{
+    parallelThreadLimit() = count;
+    TaskScheduler::shutdown();
+}
+
+// 可用的工作线程数（至少为 1）
+inline unsigned int parallelThreadCount()
+{
+    if (parallelThreadLimit() > 0)
+        return parallelThreadLimit();
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// 并行 for：把 [begin, end) 切成不小于 grain 的块，
+// 作为任务交给共享的 TaskScheduler 执行 fn(chunkBegin, chunkEnd)，调用线程也参与计算
+template <typename Fn>
+void parallelFor(size_t begin, size_t end, size_t grain, Fn &&fn)
+{
+    if (end <= begin)
+        return;
+
+    // 只有一块或单线程时直接执行，省掉任务的开销
+    grain = std::max<size_t>(grain, 1);
+    if (end - begin <= grain || parallelThreadCount() <= 1)
+    {
+        fn(begin, end);
+        return;
+    }
+    TaskScheduler::instance().parallelFor(begin, end, grain, fn);
+}
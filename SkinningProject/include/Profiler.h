@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// 轻量的性能分析器：PROFILE_SCOPE 记录一个作用域在当前线程上的起止时间，
+// GPU_PROFILE_SCOPE 用 GL 时间戳查询记录同一段命令在 GPU 上的耗时，
+// 最后导出为 Chrome trace-event JSON（chrome://tracing 或 ui.perfetto.dev 打开）。
+// 每个线程只往自己的事件缓冲追加，记录时不加锁；未启用时每个作用域只多一次判断
+class Profiler
+{
+public:
+    // 开始记录。启用前的作用域不会被记录
+    static void setEnabled(bool enable);
+    static bool enabled() { return active; }
+
+    // 单调时钟，纳秒
+    static uint64_t now();
+
+    // 当前帧号，之后记录的事件带上该帧号（-1 表示不属于某一帧，例如加载阶段）
+    static void setFrame(int frame);
+    static int frame();
+
+    // 在当前线程的缓冲中记录一个区间 [start, end)。name 必须是静态字符串
+    static void record(const char *name, uint64_t start, uint64_t end);
+    // 记录一段 GPU 耗时（时间已换算到 CPU 时钟），单独显示在 "GPU" 轨道上；只能在 GL 线程调用
+    static void recordGpu(const char *name, uint64_t start, uint64_t end, int frame);
+
+    // 导出所有线程的事件。调用时不能再有线程在记录（各线程已 join）
+    static bool writeChromeTrace(const std::string &path);
+
+private:
+    static inline bool active = false;
+};
+
+// 作用域计时：构造时取开始时间，析构时记录
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char *name) : name(name), start(Profiler::enabled() ? Profiler::now() : 0) {}
+    ~ProfileZone()
+    {
+        if (start)
+            Profiler::record(name, start, Profiler::now());
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+// GPU 计时：在命令流中插入起止两个时间戳查询，结果在之后的 GpuProfiler::collect 中取回，不阻塞渲染
+class GpuProfiler
+{
+public:
+    // 需要当前 GL 上下文；对齐 GPU 时间戳和 CPU 时钟
+    static bool create();
+    // 取回已经完成的查询；wait 为 true 时等待所有查询完成（销毁上下文前调用）
+    static void collect(bool wait);
+    static void destroy();
+
+    // 返回区间序号，未创建或未启用时返回 -1
+    static int begin(const char *name);
+    static void end(int zone);
+};
+
+class GpuProfileZone
+{
+public:
+    explicit GpuProfileZone(const char *name) : zone(GpuProfiler::begin(name)) {}
+    ~GpuProfileZone() { GpuProfiler::end(zone); }
+
+    GpuProfileZone(const GpuProfileZone &) = delete;
+    GpuProfileZone &operator=(const GpuProfileZone &) = delete;
+
+private:
+    int zone;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define GPU_PROFILE_SCOPE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
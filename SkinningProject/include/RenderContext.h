@@ -0,0 +1,45 @@
+#pragma once
+
+struct GLFWwindow;
+
+// OpenGL 上下文的创建方式
+enum class ContextBackend
+{
+    GLFW, // 隐藏的 GLFW 窗口，需要窗口系统，交互使用
+    EGL   // 无表面（surfaceless）EGL 上下文，无需 X/Wayland，可在 Mesa llvmpipe 上运行
+};
+
+// OpenGL 上下文和离屏帧缓冲。两种后端都渲染到同一个 FBO 中，读回路径完全一致。
+// FBO 中的图像是上下翻转的（自上而下的行序，与输出文件一致）
+class RenderContext
+{
+public:
+    RenderContext();
+    ~RenderContext();
+
+    bool create(ContextBackend backend, int width, int height);
+    void destroy();
+
+    // GLFW：把 FBO 翻转回来拷到窗口后交换缓冲；EGL：无操作
+    void swapBuffers();
+    void pollEvents();
+
+    unsigned int framebuffer() const { return fbo; }
+    ContextBackend getBackend() const { return backend; }
+
+    // 是否编译了 EGL 支持
+    static bool hasEGL();
+
+private:
+    bool createGLFW();
+    bool createEGL();
+    bool createFramebuffer();
+
+    ContextBackend backend;
+    int width, height;
+    GLFWwindow *window;
+    void *eglDisplay;
+    void *eglContext;
+    void *eglSurface; // 驱动不支持 surfaceless 时使用的 1x1 pbuffer
+    unsigned int fbo, colorBuffer, depthBuffer;
+};
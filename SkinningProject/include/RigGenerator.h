@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// 合成角色的参数。骨架是一棵“肢体”树：根肢体之下每个肢体末端分出 fanout 个子肢体，共 depth 层，
+// 每个肢体是一条 bonesPerLimb 节的骨骼链，外面包一根两端封口的圆管（胶囊）
+struct RigParams
+{
+    int depth = 3;             // 子肢体的层数（0 表示只有根肢体）
+    int fanout = 3;            // 每个肢体末端的子肢体数
+    int bonesPerLimb = 4;      // 每个肢体的骨骼数
+    size_t maxBones = 0;       // 骨骼总数上限，按层序截断，0 表示不限
+    size_t targetVertices = 100000; // 目标顶点数（按 Mesh::loadOBJ 加载后的面角顶点计，即三角形数 x 3）
+    float limbLength = 2.0f;   // 根肢体长度，子肢体逐层缩短
+    float limbRadius = 0.3f;   // 根肢体半径，子肢体逐层变细
+    unsigned int seed = 1;     // 随机种子：相同参数和种子生成完全相同的文件
+
+    // 给定骨骼数和顶点数的参数：固定 fanout，选最浅的层数和每肢体骨骼数使总数不少于 bones，再截断到 bones
+    static RigParams forBoneCount(size_t bones, size_t vertices, unsigned int seed = 1);
+};
+
+// 生成的骨骼：与 skeleton.json 的字段一致
+struct GeneratedBone
+{
+    std::string name;
+    int parent; // -1 表示根
+    glm::vec3 head;
+    glm::vec3 tail;
+};
+
+// 程序化生成的带骨架角色，可写成现有的 OBJ + skeleton.json 格式
+class RigGenerator
+{
+public:
+    bool generate(const RigParams &params);
+
+    bool writeOBJ(const std::string &path) const;
+    bool writeSkeleton(const std::string &path) const;
+
+    const std::vector<GeneratedBone> &bones() const { return boneList; }
+    size_t triangleCount() const { return triangles.size() / 3; }
+    // 按 Mesh::loadOBJ 计的顶点数（每个三角形 3 个面角顶点）
+    size_t loadedVertexCount() const { return triangles.size(); }
+
+private:
+    std::vector<GeneratedBone> boneList;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> triangles; // 指向 positions / normals，从 0 开始
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include "TriangleBVH.h"
+#include "Skeleton.h"
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+// 线段 a-b 加半径
+struct Capsule
+{
+    glm::vec3 a = glm::vec3(0.0f);
+    glm::vec3 b = glm::vec3(0.0f);
+    float radius = -1.0f; // 小于 0 表示该骨骼没有主导的三角形
+};
+
+// 一对相交的三角形：first 属于骨骼 firstBone，second 属于骨骼 secondBone（firstBone < secondBone）。
+// 两个三角形都属于多个骨骼时，记在编号最小的候选骨骼对下，每对三角形只报告一次
+struct TrianglePair
+{
+    int first, second;
+    int firstBone, secondBone;
+    float depth; // 穿透深度：两个三角形沿对方法线陷入对方背面的距离，取较小者
+};
+
+// 一帧的检测结果
+struct SelfCollisionReport
+{
+    std::vector<TrianglePair> pairs;
+    float maxDepth = 0.0f;
+    size_t bonePairs = 0;     // 宽相位中胶囊相交的骨骼对数
+    size_t triangleTests = 0; // 窄相位中实际做了三角形相交测试的对数
+};
+
+// 蒙皮网格的自碰撞检测。三角形归属于三个顶点权重之和最大的骨骼，以及在某个顶点上权重较大的其他骨骼，
+// 一个三角形可以属于多个骨骼。
+// 宽相位：每个骨骼用一个胶囊包住它的三角形（轴在静止姿态上按主成分拟合，每帧用骨骼矩阵变换，
+// 半径按蒙皮后的顶点重新计算，因此总是保守的），父子骨骼和在同一顶点上都有较大权重的骨骼不参与检测，
+// 它们之间的接触是关节处正常的挤压。
+// 窄相位：只在胶囊相交的骨骼对之间，用 TriangleBVH 查找包围盒重叠的三角形，再做三角形相交测试。
+// 共享顶点（位置相同）的三角形是网格上相邻的面，属于同一个骨骼的三角形是同一部位，都不算碰撞
+class SelfCollision
+{
+public:
+    // 网格的 indices 必须与 TriangleBVH 构建时使用的一致
+    void prepare(const Mesh &mesh, const Skeleton &skeleton);
+
+    // bvh 已经 refit 到 vertices 的位置；palette 为本帧的骨骼矩阵（Skeleton::computeBoneMatrices 的输出）
+    void detect(const TriangleBVH &bvh, const SkinnedVertices &vertices, const glm::mat4 *palette,
+                SelfCollisionReport &report);
+
+    // 最近一次 detect 时骨骼的胶囊
+    const Capsule &capsule(int bone) const { return capsules[bone]; }
+    // 三角形所属的骨骼（按编号升序），没有权重时为 0 个
+    int ownerCount(int t) const { return ownerStart[t + 1] - ownerStart[t]; }
+    int owner(int t, int i) const { return triangleOwners[ownerStart[t] + i]; }
+    // 参与宽相位检测的骨骼对数（已去掉父子和共享影响的骨骼对）
+    size_t candidatePairCount() const { return candidatePairs.size(); }
+
+private:
+    void testBonePair(const TriangleBVH &bvh, int boneA, int boneB, std::vector<TrianglePair> &pairs,
+                      size_t &tests) const;
+    bool ownedBy(int t, int bone) const;
+    // 相交的三角形 t 和 u 是否应该记在骨骼对 boneA-boneB 下
+    bool reportedUnder(int t, int u, int boneA, int boneB) const;
+
+    std::vector<unsigned int> indices;
+    std::vector<int> corners;       // 每个三角形顶点按静止位置焊接后的序号，用于判断相邻
+    std::vector<int> ownerStart; // 三角形 t 的骨骼为 triangleOwners[ownerStart[t], ownerStart[t + 1])
+    std::vector<int> triangleOwners;
+    std::vector<std::vector<int>> boneTriangles;
+    std::vector<char> excluded; // boneCount * boneCount，不参与检测的骨骼对
+    std::vector<Capsule> restCapsules;
+    std::vector<Capsule> capsules;
+    std::vector<BoundingBox> capsuleBoxes;
+    std::vector<std::pair<int, int>> candidatePairs;
+
+    // detect 的中间结果，帧之间复用
+    std::vector<std::pair<int, int>> overlapping;
+    std::vector<std::vector<TrianglePair>> pairResults;
+    std::vector<size_t> pairTests;
+};
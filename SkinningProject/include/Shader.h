@@ -6,19 +6,61 @@
 class Shader
 {
 public:
+    // 链接后反射得到的 uniform 信息，setter 通过句柄（表中的下标）访问
+    struct Uniform
+    {
+        std::string name; // 数组去掉末尾的 "[0]"
+        int location;
+        unsigned int type;
+        int size;                         // 数组长度
+        std::vector<unsigned char> value; // 上一次上传的值，用于跳过重复上传
+    };
+
+    struct UniformBlock
+    {
+        std::string name;
+        unsigned int index;
+        int dataSize;
+    };
+
     Shader();
     ~Shader();
 
-    bool loadFromFiles(const std::string &vertexPath, const std::string &fragmentPath);
-    bool compile(const std::string &vertexCode, const std::string &fragmentCode);
+    // defines 会插入到两个着色器的 #version 行之后，用来编译特化版本（如 "#define MAX_INFLUENCES 2\n"）
+    bool loadFromFiles(const std::string &vertexPath, const std::string &fragmentPath,
+                       const std::string &defines = "");
+    bool compile(const std::string &vertexCode, const std::string &fragmentCode,
+                 const std::string &defines = "");
     void use();
-    void setMat4(const std::string &name, const glm::mat4 &mat) const;
-    void setMat4Array(const std::string &name, const std::vector<glm::mat4> &mats) const;
-    void setVec3(const std::string &name, const glm::vec3 &vec) const;
+
+    // 句柄接口：uniform() 返回 -1 表示不存在（或被编译器优化掉），此时 setter 不做任何事
+    int uniform(const std::string &name) const;
+    void setMat4(int handle, const glm::mat4 &mat);
+    void setMat4Array(int handle, const glm::mat4 *mats, int count);
+    void setVec3(int handle, const glm::vec3 &vec);
+    void setInt(int handle, int value);
+
+    // 名字接口：在反射表中查找，不再调用 glGetUniformLocation
+    void setMat4(const std::string &name, const glm::mat4 &mat);
+    void setMat4Array(const std::string &name, const std::vector<glm::mat4> &mats);
+    void setVec3(const std::string &name, const glm::vec3 &vec);
+    void setInt(const std::string &name, int value);
+
+    const std::vector<Uniform> &uniforms() const { return uniformTable; }
+    const std::vector<UniformBlock> &uniformBlocks() const { return blockTable; }
+
+    // 自上次 resetStats() 以来省掉的 GL 调用数（位置查询 + 重复上传）
+    int callsSaved() const { return savedCalls; }
+    void resetStats() { savedCalls = 0; }
 
     unsigned int getID() const { return programID; }
 
 private:
+    void reflect();
+    bool changed(Uniform &u, const void *data, size_t bytes);
+
     unsigned int programID;
+    std::vector<Uniform> uniformTable;
+    std::vector<UniformBlock> blockTable;
+    int savedCalls;
 };
-
@@ -8,5 +8,15 @@ public:
     std::vector<Bone> bones;
 
     bool loadFromJSON(const std::string &path);
+    // 按名称查找骨骼，找不到时返回 -1
+    int findBone(const std::string &name) const;
     void computePoseMatrices();
+    // 计算供渲染使用的骨骼矩阵并写入 out（bones.size() 个），out 可以是映射的 GPU 内存。
+    // 返回同样结果的线程局部缓冲，可以直接读取（out 只写不读），在本线程下一次调用前有效
+    const std::vector<glm::mat4> &computeBoneMatrices(glm::mat4 *out) const;
+    // 当前姿态中是否有骨骼带非均匀缩放或切变（此时法线需要用逆转置矩阵变换）
+    bool hasNonUniformScale() const;
+
+    // 矩阵的上 3x3 是否为旋转乘以均匀缩放
+    static bool isUniformScale(const glm::mat4 &m);
 };
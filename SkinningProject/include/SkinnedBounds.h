@@ -0,0 +1,65 @@
+#pragma once
+#include "Mesh.h"
+#include "Skeleton.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// 轴对齐包围盒，默认构造为空盒
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    BoundingBox();
+
+    bool empty() const { return min.x > max.x; }
+    // 两个盒子是否相交（边界接触也算）
+    bool overlaps(const BoundingBox &other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+    void expand(const glm::vec3 &p);
+    void expand(const BoundingBox &box);
+
+    // 仿射变换后的包围盒（中心 + 半长按 |M| 变换，结果仍然包住变换后的原盒）
+    BoundingBox transformed(const glm::mat4 &m) const;
+};
+
+// 视锥体：6 个平面从 projection * view 中提取，法线指向视锥内部
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+    // 包围盒是否可能与视锥相交（保守：只有完全在某个平面外侧时才返回 false）
+    bool intersects(const BoundingBox &box) const;
+};
+
+// 蒙皮网格的保守包围盒：预先统计每个骨骼影响的顶点在绑定空间中的包围盒，
+// 每帧把它们用骨骼矩阵变换后取并集，代价只与骨骼数有关，与顶点数无关。
+// 权重归一化时，蒙皮后的顶点是各影响骨骼变换结果的凸组合，必然落在这些变换后的盒子的并集内
+class SkinnedBounds
+{
+public:
+    // 按骨骼层次把骨骼分成 partitions 组：深度优先序中连续的一段为一组，各组主导的顶点数大致相等。
+    // 返回每个骨骼的组号，供 Mesh::sortByInfluenceCount 按组切分绘制区间
+    static std::vector<int> partitionBones(const Skeleton &skeleton, const Mesh &mesh, int partitions);
+
+    // 统计每个骨骼的绑定空间包围盒，以及每个绘制区间内的顶点受哪些骨骼影响
+    void build(const Mesh &mesh, size_t boneCount, const std::vector<DrawRange> &ranges);
+
+    // 用骨骼矩阵（Skeleton::computeBoneMatrices 的输出）和模型矩阵计算世界空间包围盒：
+    // character 为整个角色，rangeBounds（可为空）为每个绘制区间（rangeCount() 个）
+    void compute(const glm::mat4 *palette, const glm::mat4 &model,
+                 BoundingBox &character, BoundingBox *rangeBounds) const;
+
+    size_t rangeCount() const { return rangeBones.size(); }
+
+private:
+    std::vector<BoundingBox> boneBoxes; // 每个骨骼影响的顶点（绑定空间）
+    BoundingBox restBox;                // 没有权重的顶点，不随骨骼变形
+    // 每个绘制区间用到的骨骼；-1 表示包含没有权重的顶点
+    std::vector<std::vector<int>> rangeBones;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "CpuSkinning.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// 纯 CPU 的分块光栅化后端，用于没有 GPU 的机器（替代 llvmpipe）。
+// 场景固定：蒙皮网格 + 一个方向光，着色与 skinning.frag 相同的 Phong 光照。
+// 流程：drawMesh 做顶点变换并记录三角形；endFrame 中三角形建立后按屏幕分块（tile）分桶，
+// 各个 tile 并行光栅化：8x8 像素块级的层次深度剔除 + 可见性缓冲（每像素只记最近三角形），
+// 全部三角形处理完后每个像素只着色一次，结果直接写入输出帧缓冲（自上而下的行序）
+class SoftwareRenderer
+{
+public:
+    static const int TILE_SIZE = 64;
+    static const int BLOCK_SIZE = 8;
+
+    SoftwareRenderer();
+
+    // channels: 输出缓冲的通道数（3 = RGB，4 = RGBA），与帧输出一致
+    bool create(int width, int height, int channels);
+
+    // 开始一帧。projection 为普通（未翻转）的投影矩阵
+    void beginFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos,
+                    const glm::vec3 &lightDir, const glm::vec3 &lightColor, const glm::vec3 &clearColor);
+
+    // 提交一个已蒙皮的网格实例：skinned 为对象空间结果，model 为实例的模型矩阵
+    void drawMesh(const SkinnedVertices &skinned, const std::vector<unsigned int> &indices, const glm::mat4 &model);
+
+    // 光栅化并着色本帧提交的全部三角形
+    void endFrame();
+
+    const unsigned char *pixels() const { return color.data(); }
+    size_t triangleCount() const { return triangleTotalLastFrame; }
+
+private:
+    // 变换后的顶点：屏幕坐标（像素，自上而下）、NDC 深度（[0, 1]）、1/w，以及着色用的世界空间属性
+    struct ScreenVertex
+    {
+        float x, y, z, invW;
+        glm::vec3 world;
+        glm::vec3 normal;
+    };
+
+    // 三角形建立结果：三条边函数按面积归一化，在像素中心求值直接得到重心坐标。
+    // 边函数和深度平面都以顶点 0 为原点：E(x, y) = A (x - originX) + B (y - originY) + C
+    struct Triangle
+    {
+        unsigned int v[3];
+        float originX, originY;
+        float edgeA[3], edgeB[3], edgeC[3];
+        float zA, zB, zC; // 深度平面，同样相对于顶点 0
+        float minZ;
+        int x0, y0, x1, y1; // 包围盒（像素，含端点）
+    };
+
+    void setupTriangles(size_t begin, size_t end, std::vector<std::vector<unsigned int>> &bins);
+    void rasterizeTile(int tile);
+    void shadeTile(int tile, const std::vector<unsigned int> &visible);
+    void storeColor(size_t pixel, const glm::vec3 &rgb);
+
+    int width, height, channels;
+    int tilesX, tilesY;
+
+    glm::mat4 viewProjection;
+    glm::vec3 viewPos, lightDir, lightColor, clearColor;
+
+    // 以下缓冲跨帧复用，只用前 vertexCount / indexCount 项
+    std::vector<ScreenVertex> vertices;
+    std::vector<unsigned int> indices; // 本帧所有实例的三角形（指向 vertices）
+    std::vector<Triangle> triangles;
+    size_t vertexCount, indexCount, triangleTotalLastFrame;
+
+    // 分桶：每个建立任务一组 tile 列表，按任务顺序合并即保持提交顺序
+    std::vector<std::vector<std::vector<unsigned int>>> chunkBins;
+    size_t recordedScratch = 0; // 上次登记给 MemoryStats 的复用缓冲大小，变化时才重新登记
+
+    std::vector<unsigned char> color;
+    std::vector<unsigned char> clearRow; // TILE_SIZE 个背景色像素
+};
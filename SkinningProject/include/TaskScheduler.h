@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// 任务的类别。计算任务在工作线程之间偷取，等待计算任务的线程会帮忙执行；
+// IO 任务（编码、写盘）只由专门的 IO 线程按提交顺序执行，渲染线程等待时不会把它们拿来执行
+enum class TaskKind
+{
+    Compute,
+    IO
+};
+
+// 调度器中的一个任务。由 TaskScheduler::submit 创建，所依赖的任务全部完成后才会被执行
+class Task
+{
+public:
+    bool done() const { return finished.load(); }
+
+private:
+    friend class TaskScheduler;
+
+    std::function<void()> fn;
+    TaskKind kind = TaskKind::Compute;
+    std::atomic<int> pending{1}; // 未完成的依赖数 + 1（提交过程中的保护计数）
+    std::atomic<bool> finished{false};
+    std::mutex mutex; // 保护 successors，与完成标记的设置互斥
+    std::vector<std::shared_ptr<Task>> successors;
+};
+
+using TaskRef = std::shared_ptr<Task>;
+
+// 每个线程的调度统计。下标 0 是创建调度器的线程（主线程），最后一个是 IO 线程，其余为工作线程
+struct SchedulerStats
+{
+    uint64_t tasks;     // 执行的任务数
+    uint64_t steals;    // 从其他线程的队列偷来的任务数
+    double idleSeconds; // 没有任务可做而睡眠的时间
+};
+
+// 全项目共用的 work-stealing 任务调度器：每个线程一个双端队列，自己从尾部取（后进先出，缓存友好），
+// 空闲时从其他线程队列的头部偷（先进先出，偷到的是较大的早期任务）。
+// 等待计算任务的线程（包括主线程）不会阻塞，而是一边等一边执行队列中的计算任务。
+// IO 任务走单独的队列，由一个专门的 IO 线程执行，不占用渲染线程。
+// 工作线程在第一次使用时创建，之后常驻，避免每次 parallelFor 都创建线程
+class TaskScheduler
+{
+public:
+    static TaskScheduler &instance();
+
+    // 等待工作线程处理完队列并退出，销毁调度器；下次使用时按新的线程数重建。
+    // fork 前（子进程不继承线程）和修改线程数后调用，调用时不能有其他线程在使用调度器
+    static void shutdown();
+
+    // 并行度：parallelFor 按它切分任务
+    unsigned int threadCount() const { return parallelism; }
+
+    // 提交任务，dependencies 中的任务全部完成后才会执行
+    TaskRef submit(std::function<void()> fn, const std::vector<TaskRef> &dependencies = {},
+                   TaskKind kind = TaskKind::Compute);
+
+    // 等待任务完成。等待计算任务时执行其他计算任务；等待 IO 任务时直接睡眠，不执行任何任务
+    void wait(const TaskRef &task);
+
+    // 把 [begin, end) 切成不小于 grain 的块执行，调用线程参与，返回时全部完成。
+    // 调用线程只执行这次循环的块，不会执行队列中的其他任务
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+    std::vector<SchedulerStats> stats() const;
+    void resetStats();
+    void printStats(std::ostream &out) const;
+
+private:
+    explicit TaskScheduler(unsigned int threadLimit);
+    ~TaskScheduler();
+
+    // 用互斥锁保护的双端队列：每次操作只锁一个队列，竞争只发生在偷取时
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<TaskRef> queue; // 尾部由所属线程存取，头部被偷
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> idleNanoseconds{0};
+    };
+
+    int currentSlot() const;
+    void enqueue(TaskRef task);
+    TaskRef findWork(int slot);
+    void execute(const TaskRef &task, Worker *owner);
+    void workerLoop(int slot);
+    void ioLoop();
+    void idle(Worker *owner, const std::function<bool()> &ready);
+
+    const uint64_t generation; // 区分先后创建的调度器，线程的槽位只对创建它的调度器有效
+    const unsigned int parallelism;
+    std::vector<std::unique_ptr<Worker>> workers; // 0 号属于创建调度器的线程
+    std::vector<std::thread> threads;
+
+    Worker io; // IO 线程：queue 是 IO 任务队列，按提交顺序执行，不参与偷取
+    std::condition_variable ioWake;
+    std::thread ioThread;
+
+    std::mutex injectionMutex; // 调度器之外的线程提交的任务
+    std::deque<TaskRef> injection;
+
+    std::atomic<size_t> queued{0}; // 所有计算队列中的任务数，空闲线程据此判断是否有活可干
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stopping{false};
+};
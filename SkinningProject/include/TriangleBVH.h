@@ -0,0 +1,94 @@
+#pragma once
+#include "CpuSkinning.h"
+#include "SkinnedBounds.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction; // 不要求归一化，命中距离 t 以 direction 的长度为单位
+};
+
+struct RayHit
+{
+    int triangle = -1; // 三角形序号（indices 中第 triangle * 3 项开始）
+    float t = 0.0f;
+    float u = 0.0f, v = 0.0f; // 重心坐标：命中点 = (1 - u - v) p0 + u p1 + v p2
+};
+
+struct PointHit
+{
+    int triangle = -1;
+    glm::vec3 point = glm::vec3(0.0f); // 三角形上离查询点最近的点
+    float distance = 0.0f;
+};
+
+// 蒙皮网格三角形上的包围体层次（BVH）。拓扑（Mesh::indices）不变，只有顶点位置逐帧变化：
+// 树按静止姿态用分箱 SAH 构建一次，之后每帧用 CPU 蒙皮的结果自底向上重新计算包围盒（refit），不改变树结构。
+// 姿态离构建时越远，refit 后的包围盒重叠越多；每次 refit 计算树的 SAH 代价，
+// 比构建时差到一定程度（rebuildRatio）再按当前位置重建
+class TriangleBVH
+{
+public:
+    // 在网格的静止姿态上构建
+    void build(const Mesh &mesh);
+    // 在给定的顶点位置上构建；indices 为三角形列表
+    void build(const std::vector<unsigned int> &indices, const SkinnedVertices &vertices);
+
+    // 用新的顶点位置更新包围盒。SAH 代价超过构建时的 rebuildRatio 倍时重建，返回是否重建
+    bool refit(const SkinnedVertices &vertices);
+
+    void setRebuildRatio(float ratio) { rebuildRatio = ratio; }
+
+    // 最近的命中，tMax 之外的不算
+    bool raycast(const Ray &ray, float tMax, RayHit &hit) const;
+    // 距离 p 最近的三角形，maxDistance 之外的不算
+    bool closestPoint(const glm::vec3 &p, float maxDistance, PointHit &hit) const;
+    // 包围盒与 box 相交的所有三角形，追加到 triangles
+    void query(const BoundingBox &box, std::vector<int> &triangles) const;
+
+    // 三角形 t 当前的三个顶点
+    void triangle(int t, glm::vec3 &p0, glm::vec3 &p1, glm::vec3 &p2) const;
+    const BoundingBox &triangleBounds(int t) const { return triangleBoxes[t]; }
+    size_t triangleCount() const { return triangleBoxes.size(); }
+    BoundingBox bounds() const { return nodes.empty() ? BoundingBox() : nodes[0].box; }
+
+    // 树的 SAH 代价（相对于根节点的面积）：当前值和最近一次构建时的值
+    float sahCost() const { return currentCost; }
+    float builtSahCost() const { return buildCost; }
+    size_t nodeCount() const { return nodes.size(); }
+    int rebuildCount() const { return rebuilds; }
+
+private:
+    // 节点按深度优先的先序存放：左孩子紧跟在父节点之后，一棵子树占用一段连续的下标
+    struct Node
+    {
+        BoundingBox box;
+        int right; // 内部节点：右孩子下标；叶子：第一个三角形在 order 中的位置
+        int count; // 叶子的三角形数，内部节点为 0
+    };
+
+    void rebuild();
+    int buildNode(int first, int count, int depth);
+    void refitNode(int node);
+    void refitRange(int begin, int end);
+    float computeCost() const;
+
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions;
+    std::vector<BoundingBox> triangleBoxes;
+    std::vector<glm::vec3> centroids; // 只在构建时使用
+    std::vector<int> order;           // 叶子中的三角形序号
+    std::vector<Node> nodes;
+
+    // 并行 refit 的划分：每项是一棵子树的下标区间 [begin, end)，彼此不相交；
+    // 不在这些子树中的上层节点（topNodes，先序）在之后串行更新
+    std::vector<std::pair<int, int>> subtrees;
+    std::vector<int> topNodes;
+
+    float rebuildRatio = 1.5f;
+    float buildCost = 0.0f;
+    float currentCost = 0.0f;
+    int rebuilds = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include "FrameSink.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct iovec;
+
+// 原始帧容器文件的头部，占文件开头的 HEADER_SIZE 字节（其余补零）。
+// 第 k 帧的 RGB 数据位于 dataOffset + k * frameStride，长度 frameBytes；
+// frameStride 在 O_DIRECT 模式下按 4096 对齐，多出的部分为填充
+struct RawContainerHeader
+{
+    char magic[8];       // "ATCARAW1"
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t frameCount;
+    uint64_t frameBytes;
+    uint64_t frameStride;
+    uint64_t dataOffset;
+};
+
+// io_uring 原始帧输出（仅 Linux）：预分配一个容器文件，每帧拷进缓冲池中的一块对齐缓冲后
+// 以异步写提交，渲染线程不等待页缓存；写完成后缓冲回到池中，池空时才等待最早的完成事件。
+// 直接使用 io_uring_setup / io_uring_enter 系统调用，不依赖 liburing
+class UringWriter : public FrameSink
+{
+public:
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr size_t ALIGNMENT = 4096;
+
+    // directIO：以 O_DIRECT 打开，绕过页缓存（文件系统不支持时自动退回普通写）
+    UringWriter(const std::string &path, int width, int height, int frameCount,
+                int buffers, bool directIO);
+    ~UringWriter() override;
+
+    // 编译时没有 io_uring 支持时总是返回 false
+    static bool isAvailable();
+
+    // 创建 ring、打开并预分配文件、写入头部；失败时返回 false，调用方可以改用其他输出。
+    // create 为 false 时打开已经创建好的容器文件（分片进程各自写入自己的帧区间）
+    bool open(bool create = true);
+
+    void writeFrame(int frame, const unsigned char *pixels) override;
+    void finish() override;
+    const char *describe() const override;
+
+    size_t frameStride() const { return stride; }
+    bool usingDirectIO() const { return direct; }
+
+private:
+    struct Buffer
+    {
+        unsigned char *data = nullptr;
+        int frame = -1;
+        size_t length = 0;
+        struct iovec *iov = nullptr; // 提交期间必须保持有效
+    };
+
+    bool setupRing(unsigned entries);
+    void submit(int buffer, uint64_t offset);
+    // 收取完成事件；wait 为 true 时至少等到一个
+    void reap(bool wait);
+    void close();
+
+    std::string path;
+    int width, height, frameCount;
+    size_t frameBytes, stride;
+    bool direct;
+    int fd;
+
+    std::vector<Buffer> buffers;
+    std::vector<int> freeBuffers;
+    int inFlight;
+    bool failed;
+
+    // io_uring 状态（映射的共享环）
+    int ringFd;
+    void *sqRing, *cqRing, *sqeMemory;
+    size_t sqRingSize, cqRingSize, sqeMemorySize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    void *sqes; // struct io_uring_sqe *
+    void *cqes; // struct io_uring_cqe *
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include "Mesh.h"
+#include "Skeleton.h"
+
+// 体素测地线绑定：把网格内部体素化，在实体体素中从每根骨骼出发做测地距离传播，
+// 再由距离得到权重。不依赖网格的流形性，可用于有破洞的扫描网格
+class VoxelSkinning
+{
+public:
+    // resolution: 包围盒最长边上的体素数量
+    static void computeWeights(
+        Mesh &mesh,
+        const Skeleton &skeleton,
+        int resolution = 128);
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include "Mesh.h"
+
+// 权重后处理：在网格邻接上做 Jacobi 拉普拉斯平滑，消除相邻顶点间
+// 前 4 个影响骨骼突变造成的接缝。每次迭代后重新选取前 4 个骨骼并归一化
+class WeightSmoothing
+{
+public:
+    // lambda: 每次迭代向邻居平均值靠拢的比例
+    static void smooth(
+        Mesh &mesh,
+        int iterations,
+        float lambda = 0.5f);
+};
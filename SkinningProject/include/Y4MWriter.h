@@ -0,0 +1,43 @@
+#pragma once
+#include "FrameSink.h"
+#include "TaskScheduler.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 单个 Y4M（YUV4MPEG2）视频流输出：每帧读回的 RGBA 转成 BT.709 有限范围的 YUV 4:2:0 后
+// 顺序追加到同一个文件；path 为 "-" 时写到标准输出，可以直接用管道交给编码器：
+//   SkinningProject --format y4m --output - | ffmpeg -i - -c:v libx264 output/animation.mp4
+// 颜色转换按行带并行；写盘是调度器上的任务，依赖上一帧的写任务以保证顺序，与下一帧的渲染重叠
+class Y4MWriter : public FrameSink
+{
+public:
+    Y4MWriter(const std::string &path, int width, int height, int fps);
+    ~Y4MWriter() override;
+
+    // 打开文件并写入流头，失败时返回 false
+    bool open();
+
+    // 读回 RGBA，每个像素 4 字节对齐，方便 SIMD 一次加载 4 个像素
+    int channels() const override { return 4; }
+    // 帧必须按顺序到达（同步读回和 PBO 环都满足）
+    void writeFrame(int frame, const unsigned char *pixels) override;
+    void finish() override;
+    const char *describe() const override;
+
+    bool toStdout() const { return path == "-"; }
+
+private:
+    std::string path;
+    int width, height, fps;
+    FILE *file;
+    int nextFrame;
+    std::atomic<bool> writeFailed;
+
+    // 帧缓冲环："FRAME\n" + Y + U + V，每帧一次 fwrite。复用一块缓冲前等它上次的写任务完成
+    static const int RING_SIZE = 3;
+    std::vector<unsigned char> frameData[RING_SIZE];
+    TaskRef writes[RING_SIZE];
+    TaskRef lastWrite;
+};
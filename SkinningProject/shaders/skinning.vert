@@ -1,40 +1,58 @@
 #version 330 core
+#ifndef MAX_INFLUENCES
+#define MAX_INFLUENCES 4
+#endif
+
 layout (location = 0) in vec3 aPosition;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in ivec4 aBoneIDs;
 layout (location = 3) in vec4 aWeights;
+// 逐实例属性：模型矩阵（占 4 个位置）和该实例调色板在本帧区域中的起始矩阵序号
+layout (location = 4) in mat4 aInstanceModel;
+layout (location = 8) in int aPaletteOffset;
 
-uniform mat4 uModel;
 uniform mat4 uView;
 uniform mat4 uProjection;
-uniform mat4 uBoneMatrices[200]; // 最多200个骨骼
+uniform samplerBuffer uBonePalette; // 骨骼矩阵调色板，每个矩阵占 4 个 RGBA32F 纹素
+uniform int uPaletteBase;            // 本帧调色板在纹理缓冲中的起始矩阵序号
+uniform bool uNonUniformScale;       // CPU 检测到非均匀缩放时才需要逆转置矩阵变换法线
 
 out vec3 FragPos;
 out vec3 Normal;
 
+mat4 boneMatrix(int id)
+{
+    int texel = (uPaletteBase + aPaletteOffset + id) * 4;
+    return mat4(texelFetch(uBonePalette, texel),
+                texelFetch(uBonePalette, texel + 1),
+                texelFetch(uBonePalette, texel + 2),
+                texelFetch(uBonePalette, texel + 3));
+}
+
 void main()
 {
-    // 使用热传导蒙皮：根据顶点权重混合多个骨骼变换
-    mat4 boneTransform = mat4(0.0);
-    
-    // 遍历4个骨骼权重，只使用有效的骨骼ID（>= 0）和权重（> 0）
-    for (int i = 0; i < 4; i++)
-    {
-        if (aBoneIDs[i] >= 0 && aWeights[i] > 0.0)
-        {
-            // 矩阵线性组合：boneMatrix * weight
-            boneTransform += uBoneMatrices[aBoneIDs[i]] * aWeights[i];
-        }
-    }
-    
-    // 如果所有权重都为0或骨骼ID无效，使用单位矩阵（不变换）
-    if (boneTransform == mat4(0.0))
-    {
+    // 按权重混合骨骼变换。MAX_INFLUENCES 由 Shader::compile 注入（1/2/4），
+    // 网格预处理保证每个顶点的影响按权重降序排列且不超过所在区间的影响数，
+    // 因此循环次数固定、没有逐次分支；weights[0] 为 0 说明顶点没有绑定，保持不变
+#if MAX_INFLUENCES == 1
+    mat4 boneTransform = boneMatrix(aBoneIDs[0]);
+#else
+    mat4 boneTransform = boneMatrix(aBoneIDs[0]) * aWeights[0];
+    for (int i = 1; i < MAX_INFLUENCES; i++)
+        boneTransform += boneMatrix(aBoneIDs[i]) * aWeights[i];
+#endif
+    if (aWeights[0] <= 0.0)
         boneTransform = mat4(1.0);
-    }
 
-    vec4 worldPos = uModel * boneTransform * vec4(aPosition, 1.0);
+    mat4 skinMatrix = aInstanceModel * boneTransform;
+    vec4 worldPos = skinMatrix * vec4(aPosition, 1.0);
     FragPos = vec3(worldPos);
-    Normal = mat3(transpose(inverse(uModel * boneTransform))) * aNormal;
+
+    // 刚体或均匀缩放时，上 3x3 与其逆转置只差一个缩放系数，片段着色器会归一化，
+    // 因此直接用混合后的上 3x3 变换法线，省掉每个顶点一次 4x4 求逆
+    if (uNonUniformScale)
+        Normal = mat3(transpose(inverse(skinMatrix))) * aNormal;
+    else
+        Normal = mat3(skinMatrix) * aNormal;
     gl_Position = uProjection * uView * worldPos;
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "Arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+Arena::Arena(size_t size) : blockSize(size < 4096 ? 4096 : size)
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void *Arena::allocate(size_t size, size_t alignment)
+{
+    uintptr_t aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (!cursor || aligned + size > (uintptr_t)limit)
+    {
+        // 当前块放不下：申请新块，剩余空间直接丢弃（单调分配）
+        size_t bytes = size + alignment > blockSize ? size + alignment : blockSize;
+        char *block = static_cast<char *>(std::malloc(bytes));
+        if (!block)
+            throw std::bad_alloc();
+        blocks.push_back(block);
+        reserved += bytes;
+        cursor = block;
+        limit = block + bytes;
+        aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    cursor = (char *)(aligned + size);
+    used += size;
+    return (void *)aligned;
+}
+
+std::string_view Arena::copyString(std::string_view text)
+{
+    char *copy = allocateArray<char>(text.size());
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
+
+void Arena::release()
+{
+    for (char *block : blocks)
+        std::free(block);
+    blocks.clear();
+    cursor = limit = nullptr;
+    used = reserved = 0;
+}
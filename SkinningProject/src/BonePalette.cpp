@@ -0,0 +1,104 @@
+#include "BonePalette.h"
+#include "MemoryStats.h"
+#include <glad/glad.h>
+#include <iostream>
+
+BonePalette::BonePalette() : buffer(0), texture(0), matrices(0), region(0)
+{
+    for (int i = 0; i < REGIONS; i++)
+        fences[i] = nullptr;
+}
+
+BonePalette::~BonePalette()
+{
+    destroy();
+}
+
+bool BonePalette::create(size_t capacity)
+{
+    destroy();
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (capacity == 0 || capacity * 4 * REGIONS > (size_t)maxTexels)
+    {
+        std::cerr << "Bone palette too large: " << capacity << " matrices (max "
+                  << maxTexels / (4 * REGIONS) << ")" << std::endl;
+        return false;
+    }
+
+    matrices = capacity;
+    region = 0;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, matrices * REGIONS * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    MemoryStats::set(GpuMemoryCategory::BonePalette, "Bone palette TBO", matrices * REGIONS * sizeof(glm::mat4));
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return true;
+}
+
+void BonePalette::destroy()
+{
+    for (int i = 0; i < REGIONS; i++)
+    {
+        if (fences[i])
+            glDeleteSync((GLsync)fences[i]);
+        fences[i] = nullptr;
+    }
+    if (texture != 0)
+        glDeleteTextures(1, &texture);
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+    texture = buffer = 0;
+    matrices = 0;
+    MemoryStats::set(GpuMemoryCategory::BonePalette, "Bone palette TBO", 0);
+}
+
+glm::mat4 *BonePalette::map()
+{
+    // 等待 GPU 读完这个区域（上一次使用是 REGIONS 帧之前）
+    if (fences[region])
+    {
+        GLsync sync = (GLsync)fences[region];
+        while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(sync);
+        fences[region] = nullptr;
+    }
+
+    // GL 3.3 没有持久映射（ARB_buffer_storage），每帧以非同步方式映射当前区域，
+    // 同步完全由上面的 fence 负责，驱动不会因为缓冲仍在使用而阻塞
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    void *ptr = glMapBufferRange(GL_TEXTURE_BUFFER,
+                                 region * matrices * sizeof(glm::mat4),
+                                 matrices * sizeof(glm::mat4),
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    return static_cast<glm::mat4 *>(ptr);
+}
+
+void BonePalette::unmap()
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BonePalette::fence()
+{
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGIONS;
+}
+
+void BonePalette::bind(int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+}
@@ -0,0 +1,166 @@
+#include "ColorConvert.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLOR_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // BT.709 有限范围的定点系数。亮度按 2^15 缩放；
+    // 色度输入是 2x2 块的和（4 倍），系数按 2^13 缩放，同样右移 15 位即得平均值的结果
+    const int YR = 5983, YG = 20127, YB = 2032;
+    const int UR = -824, UG = -2774, UB = 3598;
+    const int VR = 3598, VG = -3268, VB = -330;
+    const int ROUND = 1 << 14;
+
+    inline unsigned char clampByte(int x)
+    {
+        return (unsigned char)std::min(255, std::max(0, x));
+    }
+
+    inline unsigned char lumaOf(const unsigned char *p)
+    {
+        return clampByte(((YR * p[0] + YG * p[1] + YB * p[2] + ROUND) >> 15) + 16);
+    }
+
+    // 一个 2x2 块（越界时重复边缘像素）的色度
+    inline void chromaOf(const unsigned char *rgba, int width, int height, int cx, int cy,
+                         unsigned char &u, unsigned char &v)
+    {
+        int x0 = 2 * cx, x1 = std::min(2 * cx + 1, width - 1);
+        int y0 = 2 * cy, y1 = std::min(2 * cy + 1, height - 1);
+        const unsigned char *p[4] = {
+            rgba + ((size_t)y0 * width + x0) * 4, rgba + ((size_t)y0 * width + x1) * 4,
+            rgba + ((size_t)y1 * width + x0) * 4, rgba + ((size_t)y1 * width + x1) * 4};
+        int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+        int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+        int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+        u = clampByte(((UR * r + UG * g + UB * b + ROUND) >> 15) + 128);
+        v = clampByte(((VR * r + VG * g + VB * b + ROUND) >> 15) + 128);
+    }
+
+#ifdef COLOR_CONVERT_SSE2
+    // 4 个 32 位乘加结果对 [a0 a1 a2 a3] [b0 b1 b2 b3] -> [a0+a1, a2+a3, b0+b1, b2+b3]
+    inline __m128i sumPairs(__m128i a, __m128i b)
+    {
+        __m128i sa = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+        __m128i sb = _mm_add_epi32(b, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(sa), _mm_castsi128_ps(sb), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+
+    // 4 个 RGBA 像素 -> 4 个 32 位亮度值（已加偏移，未截断）
+    inline __m128i luma4(__m128i px, __m128i coef, __m128i bias)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coef);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coef);
+        return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sumPairs(lo, hi), _mm_set1_epi32(ROUND)), 15), bias);
+    }
+
+    void lumaRowSSE2(const unsigned char *rgba, int width, unsigned char *y)
+    {
+        const __m128i coef = _mm_setr_epi16(YR, YG, YB, 0, YR, YG, YB, 0);
+        const __m128i bias = _mm_set1_epi32(16);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i *src = (const __m128i *)(rgba + (size_t)x * 4);
+            __m128i y0 = luma4(_mm_loadu_si128(src), coef, bias);
+            __m128i y1 = luma4(_mm_loadu_si128(src + 1), coef, bias);
+            __m128i y2 = luma4(_mm_loadu_si128(src + 2), coef, bias);
+            __m128i y3 = luma4(_mm_loadu_si128(src + 3), coef, bias);
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+            _mm_storeu_si128((__m128i *)(y + x), packed);
+        }
+        for (; x < width; x++)
+            y[x] = lumaOf(rgba + (size_t)x * 4);
+    }
+
+    // 两行各 4 个像素 -> 2 个 2x2 块的通道和（16 位，[r g b a] [r g b a]）
+    inline __m128i blockSums(__m128i row0, __m128i row1, bool high)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i s = high ? _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero))
+                         : _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+        // 相邻两个像素相加，结果在低 64 位
+        return _mm_add_epi16(s, _mm_srli_si128(s, 8));
+    }
+
+    inline __m128i chroma4(__m128i b01, __m128i b23, __m128i coef, __m128i bias)
+    {
+        __m128i lo = _mm_madd_epi16(b01, coef);
+        __m128i hi = _mm_madd_epi16(b23, coef);
+        return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sumPairs(lo, hi), _mm_set1_epi32(ROUND)), 15), bias);
+    }
+
+    // 处理一对输入行，输出一行 U/V；返回 SIMD 处理到的色度列数
+    int chromaRowSSE2(const unsigned char *row0, const unsigned char *row1, int width,
+                      unsigned char *u, unsigned char *v)
+    {
+        const __m128i coefU = _mm_setr_epi16(UR, UG, UB, 0, UR, UG, UB, 0);
+        const __m128i coefV = _mm_setr_epi16(VR, VG, VB, 0, VR, VG, VB, 0);
+        const __m128i bias = _mm_set1_epi32(128);
+        int cx = 0;
+        // 每次 8 个像素（两个 128 位寄存器）-> 4 个色度样本
+        for (; 2 * cx + 8 <= width; cx += 4)
+        {
+            const __m128i *a = (const __m128i *)(row0 + (size_t)cx * 8);
+            const __m128i *b = (const __m128i *)(row1 + (size_t)cx * 8);
+            __m128i a0 = _mm_loadu_si128(a), a1 = _mm_loadu_si128(a + 1);
+            __m128i b0 = _mm_loadu_si128(b), b1 = _mm_loadu_si128(b + 1);
+
+            __m128i b01 = _mm_unpacklo_epi64(blockSums(a0, b0, false), blockSums(a0, b0, true));
+            __m128i b23 = _mm_unpacklo_epi64(blockSums(a1, b1, false), blockSums(a1, b1, true));
+
+            __m128i cu = chroma4(b01, b23, coefU, bias);
+            __m128i cv = chroma4(b01, b23, coefV, bias);
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(cu, cv), _mm_setzero_si128());
+
+            int words[2];
+            _mm_storel_epi64((__m128i *)words, packed);
+            std::copy((unsigned char *)&words[0], (unsigned char *)&words[0] + 4, u + cx);
+            std::copy((unsigned char *)&words[1], (unsigned char *)&words[1] + 4, v + cx);
+        }
+        return cx;
+    }
+#endif
+}
+
+void rgbaToYuv420Scalar(const unsigned char *rgba, int width, int height,
+                        unsigned char *y, unsigned char *u, unsigned char *v)
+{
+    for (size_t i = 0; i < (size_t)width * height; i++)
+        y[i] = lumaOf(rgba + i * 4);
+
+    const int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    for (int cy = 0; cy < ch; cy++)
+        for (int cx = 0; cx < cw; cx++)
+            chromaOf(rgba, width, height, cx, cy, u[(size_t)cy * cw + cx], v[(size_t)cy * cw + cx]);
+}
+
+void rgbaToYuv420(const unsigned char *rgba, int width, int height,
+                  unsigned char *y, unsigned char *u, unsigned char *v)
+{
+#ifdef COLOR_CONVERT_SSE2
+    for (int row = 0; row < height; row++)
+        lumaRowSSE2(rgba + (size_t)row * width * 4, width, y + (size_t)row * width);
+
+    const int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    for (int cy = 0; cy < ch; cy++)
+    {
+        int done = 0;
+        // 最后一行色度在高度为奇数时只有一行输入，交给标量处理
+        if (2 * cy + 1 < height)
+        {
+            done = chromaRowSSE2(rgba + (size_t)(2 * cy) * width * 4, rgba + (size_t)(2 * cy + 1) * width * 4,
+                                 width, u + (size_t)cy * cw, v + (size_t)cy * cw);
+        }
+        for (int cx = done; cx < cw; cx++)
+            chromaOf(rgba, width, height, cx, cy, u[(size_t)cy * cw + cx], v[(size_t)cy * cw + cx]);
+    }
+#else
+    rgbaToYuv420Scalar(rgba, width, height, y, u, v);
+#endif
+}
@@ -0,0 +1,412 @@
+#include "CpuSkinning.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <cmath>
+#include <utility>
+#include <glm/gtc/quaternion.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_SKINNING_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define CPU_SKINNING_AVX2
+#define AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+    const size_t LANES = 8;
+    const size_t GRAIN = 2048; // 每个并行任务至少处理的顶点数
+
+    inline float safeInverseLength(float x, float y, float z)
+    {
+        float len2 = x * x + y * y + z * z;
+        return len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+    }
+
+    // ---------------- 标量内核 ----------------
+
+    void skinLinearScalar(size_t begin, size_t end, const float *affine,
+                          const float *px, const float *py, const float *pz,
+                          const float *nx, const float *ny, const float *nz,
+                          const int *const ids[4], const float *const weights[4], SkinnedVertices &out)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            float m[12] = {};
+            for (int k = 0; k < 4; k++)
+            {
+                float w = weights[k][i];
+                if (w <= 0.0f)
+                    continue;
+                const float *b = affine + (size_t)ids[k][i] * 12;
+                for (int j = 0; j < 12; j++)
+                    m[j] += w * b[j];
+            }
+
+            float x = px[i], y = py[i], z = pz[i];
+            out.px[i] = m[0] * x + m[1] * y + m[2] * z + m[3];
+            out.py[i] = m[4] * x + m[5] * y + m[6] * z + m[7];
+            out.pz[i] = m[8] * x + m[9] * y + m[10] * z + m[11];
+
+            // 与着色器一致：法线用混合矩阵的上 3x3 变换后归一化
+            x = nx[i], y = ny[i], z = nz[i];
+            float tx = m[0] * x + m[1] * y + m[2] * z;
+            float ty = m[4] * x + m[5] * y + m[6] * z;
+            float tz = m[8] * x + m[9] * y + m[10] * z;
+            float inv = safeInverseLength(tx, ty, tz);
+            out.nx[i] = tx * inv;
+            out.ny[i] = ty * inv;
+            out.nz[i] = tz * inv;
+        }
+    }
+
+    void skinDualQuatScalar(size_t begin, size_t end, const float *dq,
+                            const float *px, const float *py, const float *pz,
+                            const float *nx, const float *ny, const float *nz,
+                            const int *const ids[4], const float *const weights[4], SkinnedVertices &out)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const float *first = dq + (size_t)ids[0][i] * 8;
+            float q[8] = {};
+            for (int k = 0; k < 4; k++)
+            {
+                float w = weights[k][i];
+                if (w <= 0.0f)
+                    continue;
+                const float *b = dq + (size_t)ids[k][i] * 8;
+                // q 与 -q 表示同一个旋转，取与第一个影响同半球的那个，避免混合时绕远路
+                if (first[0] * b[0] + first[1] * b[1] + first[2] * b[2] + first[3] * b[3] < 0.0f)
+                    w = -w;
+                for (int j = 0; j < 8; j++)
+                    q[j] += w * b[j];
+            }
+
+            float len2 = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+            float inv = len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+            float rx = q[0] * inv, ry = q[1] * inv, rz = q[2] * inv, rw = q[3] * inv;
+            float dx = q[4] * inv, dy = q[5] * inv, dz = q[6] * inv, dw = q[7] * inv;
+
+            // 平移 t = 2 (rw d - dw r + r x d)
+            float tx = 2.0f * (rw * dx - dw * rx + (ry * dz - rz * dy));
+            float ty = 2.0f * (rw * dy - dw * ry + (rz * dx - rx * dz));
+            float tz = 2.0f * (rw * dz - dw * rz + (rx * dy - ry * dx));
+
+            // 旋转 v' = v + 2 r x (r x v + rw v)
+            float x = px[i], y = py[i], z = pz[i];
+            float cx = ry * z - rz * y + rw * x;
+            float cy = rz * x - rx * z + rw * y;
+            float cz = rx * y - ry * x + rw * z;
+            out.px[i] = x + 2.0f * (ry * cz - rz * cy) + tx;
+            out.py[i] = y + 2.0f * (rz * cx - rx * cz) + ty;
+            out.pz[i] = z + 2.0f * (rx * cy - ry * cx) + tz;
+
+            x = nx[i], y = ny[i], z = nz[i];
+            cx = ry * z - rz * y + rw * x;
+            cy = rz * x - rx * z + rw * y;
+            cz = rx * y - ry * x + rw * z;
+            float ox = x + 2.0f * (ry * cz - rz * cy);
+            float oy = y + 2.0f * (rz * cx - rx * cz);
+            float oz = z + 2.0f * (rx * cy - ry * cx);
+            float ninv = safeInverseLength(ox, oy, oz);
+            out.nx[i] = ox * ninv;
+            out.ny[i] = oy * ninv;
+            out.nz[i] = oz * ninv;
+        }
+    }
+
+    // ---------------- AVX2 内核：每次 8 个顶点 ----------------
+
+#ifdef CPU_SKINNING_AVX2
+    AVX2_TARGET inline __m256 normalizeScale(__m256 x, __m256 y, __m256 z)
+    {
+        __m256 len2 = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+        // 长度为 0 时 inv 为 inf，结果取 0
+        return _mm256_and_ps(inv, _mm256_cmp_ps(len2, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+
+    AVX2_TARGET void skinLinearAVX2(size_t begin, size_t end, const float *affine,
+                                    const float *px, const float *py, const float *pz,
+                                    const float *nx, const float *ny, const float *nz,
+                                    const int *const ids[4], const float *const weights[4], SkinnedVertices &out)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256i twelve = _mm256_set1_epi32(12);
+        for (size_t i = begin; i < end; i += LANES)
+        {
+            __m256 m[12];
+            for (int j = 0; j < 12; j++)
+                m[j] = zero;
+
+            for (int k = 0; k < 4; k++)
+            {
+                __m256 w = _mm256_loadu_ps(weights[k] + i);
+                // 影响按权重降序排列，这一槽 8 个顶点都没有权重时后面的槽也不会有
+                if (_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ)) == 0)
+                    break;
+                __m256i base = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(ids[k] + i)), twelve);
+                for (int j = 0; j < 12; j++)
+                    m[j] = _mm256_fmadd_ps(w, _mm256_i32gather_ps(affine + j, base, 4), m[j]);
+            }
+
+            __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+            _mm256_storeu_ps(&out.px[i], _mm256_fmadd_ps(m[0], x, _mm256_fmadd_ps(m[1], y, _mm256_fmadd_ps(m[2], z, m[3]))));
+            _mm256_storeu_ps(&out.py[i], _mm256_fmadd_ps(m[4], x, _mm256_fmadd_ps(m[5], y, _mm256_fmadd_ps(m[6], z, m[7]))));
+            _mm256_storeu_ps(&out.pz[i], _mm256_fmadd_ps(m[8], x, _mm256_fmadd_ps(m[9], y, _mm256_fmadd_ps(m[10], z, m[11]))));
+
+            x = _mm256_loadu_ps(nx + i), y = _mm256_loadu_ps(ny + i), z = _mm256_loadu_ps(nz + i);
+            __m256 tx = _mm256_fmadd_ps(m[0], x, _mm256_fmadd_ps(m[1], y, _mm256_mul_ps(m[2], z)));
+            __m256 ty = _mm256_fmadd_ps(m[4], x, _mm256_fmadd_ps(m[5], y, _mm256_mul_ps(m[6], z)));
+            __m256 tz = _mm256_fmadd_ps(m[8], x, _mm256_fmadd_ps(m[9], y, _mm256_mul_ps(m[10], z)));
+            __m256 inv = normalizeScale(tx, ty, tz);
+            _mm256_storeu_ps(&out.nx[i], _mm256_mul_ps(tx, inv));
+            _mm256_storeu_ps(&out.ny[i], _mm256_mul_ps(ty, inv));
+            _mm256_storeu_ps(&out.nz[i], _mm256_mul_ps(tz, inv));
+        }
+    }
+
+    // v + 2 r x (r x v + rw v)
+    AVX2_TARGET inline void rotateAVX2(__m256 rx, __m256 ry, __m256 rz, __m256 rw,
+                                       __m256 &x, __m256 &y, __m256 &z)
+    {
+        __m256 cx = _mm256_fmadd_ps(rw, x, _mm256_fmsub_ps(ry, z, _mm256_mul_ps(rz, y)));
+        __m256 cy = _mm256_fmadd_ps(rw, y, _mm256_fmsub_ps(rz, x, _mm256_mul_ps(rx, z)));
+        __m256 cz = _mm256_fmadd_ps(rw, z, _mm256_fmsub_ps(rx, y, _mm256_mul_ps(ry, x)));
+        const __m256 two = _mm256_set1_ps(2.0f);
+        __m256 ox = _mm256_fmadd_ps(two, _mm256_fmsub_ps(ry, cz, _mm256_mul_ps(rz, cy)), x);
+        __m256 oy = _mm256_fmadd_ps(two, _mm256_fmsub_ps(rz, cx, _mm256_mul_ps(rx, cz)), y);
+        __m256 oz = _mm256_fmadd_ps(two, _mm256_fmsub_ps(rx, cy, _mm256_mul_ps(ry, cx)), z);
+        x = ox;
+        y = oy;
+        z = oz;
+    }
+
+    AVX2_TARGET void skinDualQuatAVX2(size_t begin, size_t end, const float *dq,
+                                      const float *px, const float *py, const float *pz,
+                                      const float *nx, const float *ny, const float *nz,
+                                      const int *const ids[4], const float *const weights[4], SkinnedVertices &out)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        for (size_t i = begin; i < end; i += LANES)
+        {
+            __m256i firstBase = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)(ids[0] + i)), 3);
+            __m256 f0 = _mm256_i32gather_ps(dq + 0, firstBase, 4);
+            __m256 f1 = _mm256_i32gather_ps(dq + 1, firstBase, 4);
+            __m256 f2 = _mm256_i32gather_ps(dq + 2, firstBase, 4);
+            __m256 f3 = _mm256_i32gather_ps(dq + 3, firstBase, 4);
+
+            __m256 q[8];
+            for (int j = 0; j < 8; j++)
+                q[j] = zero;
+
+            for (int k = 0; k < 4; k++)
+            {
+                __m256 w = _mm256_loadu_ps(weights[k] + i);
+                if (_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ)) == 0)
+                    break;
+                __m256i base = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)(ids[k] + i)), 3);
+                __m256 b[8];
+                for (int j = 0; j < 8; j++)
+                    b[j] = _mm256_i32gather_ps(dq + j, base, 4);
+                // 与第一个影响不在同一半球时权重取反
+                __m256 d = _mm256_fmadd_ps(f0, b[0], _mm256_fmadd_ps(f1, b[1], _mm256_fmadd_ps(f2, b[2], _mm256_mul_ps(f3, b[3]))));
+                w = _mm256_xor_ps(w, _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_LT_OQ), signBit));
+                for (int j = 0; j < 8; j++)
+                    q[j] = _mm256_fmadd_ps(w, b[j], q[j]);
+            }
+
+            __m256 len2 = _mm256_fmadd_ps(q[0], q[0], _mm256_fmadd_ps(q[1], q[1], _mm256_fmadd_ps(q[2], q[2], _mm256_mul_ps(q[3], q[3]))));
+            __m256 inv = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2)),
+                                       _mm256_cmp_ps(len2, zero, _CMP_GT_OQ));
+            __m256 rx = _mm256_mul_ps(q[0], inv), ry = _mm256_mul_ps(q[1], inv);
+            __m256 rz = _mm256_mul_ps(q[2], inv), rw = _mm256_mul_ps(q[3], inv);
+            __m256 dx = _mm256_mul_ps(q[4], inv), dy = _mm256_mul_ps(q[5], inv);
+            __m256 dz = _mm256_mul_ps(q[6], inv), dw = _mm256_mul_ps(q[7], inv);
+
+            const __m256 two = _mm256_set1_ps(2.0f);
+            __m256 tx = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(rw, dx, _mm256_mul_ps(dw, rx)), _mm256_fmsub_ps(ry, dz, _mm256_mul_ps(rz, dy))));
+            __m256 ty = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(rw, dy, _mm256_mul_ps(dw, ry)), _mm256_fmsub_ps(rz, dx, _mm256_mul_ps(rx, dz))));
+            __m256 tz = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(rw, dz, _mm256_mul_ps(dw, rz)), _mm256_fmsub_ps(rx, dy, _mm256_mul_ps(ry, dx))));
+
+            __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+            rotateAVX2(rx, ry, rz, rw, x, y, z);
+            _mm256_storeu_ps(&out.px[i], _mm256_add_ps(x, tx));
+            _mm256_storeu_ps(&out.py[i], _mm256_add_ps(y, ty));
+            _mm256_storeu_ps(&out.pz[i], _mm256_add_ps(z, tz));
+
+            x = _mm256_loadu_ps(nx + i), y = _mm256_loadu_ps(ny + i), z = _mm256_loadu_ps(nz + i);
+            rotateAVX2(rx, ry, rz, rw, x, y, z);
+            __m256 ninv = normalizeScale(x, y, z);
+            _mm256_storeu_ps(&out.nx[i], _mm256_mul_ps(x, ninv));
+            _mm256_storeu_ps(&out.ny[i], _mm256_mul_ps(y, ninv));
+            _mm256_storeu_ps(&out.nz[i], _mm256_mul_ps(z, ninv));
+        }
+    }
+#endif
+}
+
+CpuSkinning::CpuSkinning() : count(0), padded(0), useAVX2(hasAVX2()) {}
+
+bool CpuSkinning::hasAVX2()
+{
+#if defined(CPU_SKINNING_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(CPU_SKINNING_AVX2)
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void CpuSkinning::prepare(const Mesh &mesh)
+{
+    count = mesh.vertices.size();
+    padded = (count + LANES - 1) / LANES * LANES;
+
+    px.assign(padded, 0.0f);
+    py.assign(padded, 0.0f);
+    pz.assign(padded, 0.0f);
+    nx.assign(padded, 0.0f);
+    ny.assign(padded, 0.0f);
+    nz.assign(padded, 0.0f);
+    for (int k = 0; k < 4; k++)
+    {
+        ids[k].assign(padded, 0);
+        weights[k].assign(padded, 0.0f);
+    }
+
+    MemoryStats::set(MemoryCategory::Caches, "CPU skinning input", padded * 14 * sizeof(float));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex &v = mesh.vertices[i];
+        px[i] = v.position.x;
+        py[i] = v.position.y;
+        pz[i] = v.position.z;
+        nx[i] = v.normal.x;
+        ny[i] = v.normal.y;
+        nz[i] = v.normal.z;
+
+        // 有效影响按权重降序放进前面的槽，内核遇到全零的槽就可以提前结束
+        int slot = 0;
+        int order[4] = {0, 1, 2, 3};
+        for (int a = 1; a < 4; a++)
+            for (int b = a; b > 0 && v.weights[order[b]] > v.weights[order[b - 1]]; b--)
+                std::swap(order[b], order[b - 1]);
+        for (int a = 0; a < 4; a++)
+        {
+            int k = order[a];
+            if (v.boneIDs[k] < 0 || v.weights[k] <= 0.0f)
+                continue;
+            ids[slot][i] = v.boneIDs[k] + 1;
+            weights[slot][i] = v.weights[k];
+            slot++;
+        }
+        // 没有权重的顶点（着色器中 aWeights[0] <= 0 时用单位矩阵）完全跟随单位变换
+        if (slot == 0)
+            weights[0][i] = 1.0f;
+    }
+    // 补齐的顶点同样指向单位变换
+    for (size_t i = count; i < padded; i++)
+        weights[0][i] = 1.0f;
+}
+
+void CpuSkinning::uploadPalette(const glm::mat4 *palette, size_t boneCount, Mode mode)
+{
+    // 第 0 项是单位变换，骨骼 b 放在第 b + 1 项
+    if (mode == Mode::Linear)
+    {
+        affine.resize((boneCount + 1) * 12);
+        for (size_t b = 0; b <= boneCount; b++)
+        {
+            const glm::mat4 m = b > 0 ? palette[b - 1] : glm::mat4(1.0f);
+            float *dst = &affine[b * 12];
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 4; c++)
+                    dst[r * 4 + c] = m[c][r];
+        }
+    }
+    else
+    {
+        dualQuats.resize((boneCount + 1) * 8);
+        for (size_t b = 0; b <= boneCount; b++)
+        {
+            const glm::mat4 m = b > 0 ? palette[b - 1] : glm::mat4(1.0f);
+            // 去掉可能存在的均匀缩放后取旋转
+            glm::mat3 rotation(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])),
+                               glm::normalize(glm::vec3(m[2])));
+            glm::quat real = glm::normalize(glm::quat_cast(rotation));
+            glm::quat dual = glm::quat(0.0f, glm::vec3(m[3])) * real * 0.5f;
+            float *dst = &dualQuats[b * 8];
+            dst[0] = real.x;
+            dst[1] = real.y;
+            dst[2] = real.z;
+            dst[3] = real.w;
+            dst[4] = dual.x;
+            dst[5] = dual.y;
+            dst[6] = dual.z;
+            dst[7] = dual.w;
+        }
+    }
+}
+
+void CpuSkinning::skin(const glm::mat4 *palette, size_t boneCount, Mode mode, SkinnedVertices &out)
+{
+    PROFILE_SCOPE("CPU skinning");
+    uploadPalette(palette, boneCount, mode);
+
+    out.count = count;
+    for (auto *v : {&out.px, &out.py, &out.pz, &out.nx, &out.ny, &out.nz})
+        v->resize(padded);
+    const size_t outputBytes = 6 * MemoryStats::bytes(out.px);
+    if (outputBytes != recordedOutput)
+    {
+        MemoryStats::set(MemoryCategory::Caches, "CPU skinned vertices", outputBytes);
+        recordedOutput = outputBytes;
+    }
+
+    const int *idPtr[4];
+    const float *weightPtr[4];
+    for (int k = 0; k < 4; k++)
+    {
+        idPtr[k] = ids[k].data();
+        weightPtr[k] = weights[k].data();
+    }
+
+    const bool avx2 = useAVX2;
+    const float *table = mode == Mode::Linear ? affine.data() : dualQuats.data();
+    parallelFor(0, padded / LANES, GRAIN / LANES, [&](size_t b, size_t e)
+                {
+                    size_t begin = b * LANES, end = e * LANES;
+#ifdef CPU_SKINNING_AVX2
+                    if (avx2)
+                    {
+                        if (mode == Mode::Linear)
+                            skinLinearAVX2(begin, end, table, px.data(), py.data(), pz.data(), nx.data(), ny.data(), nz.data(), idPtr, weightPtr, out);
+                        else
+                            skinDualQuatAVX2(begin, end, table, px.data(), py.data(), pz.data(), nx.data(), ny.data(), nz.data(), idPtr, weightPtr, out);
+                        return;
+                    }
+#endif
+                    (void)avx2;
+                    if (mode == Mode::Linear)
+                        skinLinearScalar(begin, end, table, px.data(), py.data(), pz.data(), nx.data(), ny.data(), nz.data(), idPtr, weightPtr, out);
+                    else
+                        skinDualQuatScalar(begin, end, table, px.data(), py.data(), pz.data(), nx.data(), ny.data(), nz.data(), idPtr, weightPtr, out);
+                });
+}
@@ -0,0 +1,106 @@
+#include "FrameReadback.h"
+#include "MemoryStats.h"
+#include <glad/glad.h>
+
+FrameReadback::FrameReadback() : width(0), height(0), channels(3), next(0), oldest(0), pending(0) {}
+
+FrameReadback::~FrameReadback()
+{
+    destroy();
+}
+
+bool FrameReadback::create(int w, int h, int ringSize, int c)
+{
+    destroy();
+    width = w;
+    height = h;
+    channels = c == 4 ? 4 : 3;
+    slots.resize(ringSize < 1 ? 1 : ringSize);
+    next = oldest = pending = 0;
+
+    for (auto &slot : slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    MemoryStats::set(GpuMemoryCategory::PixelBuffer, "Readback PBO ring", slots.size() * frameBytes());
+    return true;
+}
+
+void FrameReadback::destroy()
+{
+    for (auto &slot : slots)
+    {
+        if (slot.fence)
+            glDeleteSync((GLsync)slot.fence);
+        if (slot.pbo != 0)
+            glDeleteBuffers(1, &slot.pbo);
+    }
+    slots.clear();
+    next = oldest = pending = 0;
+    MemoryStats::set(GpuMemoryCategory::PixelBuffer, "Readback PBO ring", 0);
+}
+
+void FrameReadback::readFrame(int frame, const Callback &onReady)
+{
+    // 先收掉已经就绪的帧；ring 仍然是满的就只能等最旧的一帧
+    poll(onReady);
+    if (pending == slots.size())
+        complete(slots[oldest], true, onReady);
+
+    Slot &slot = slots[next];
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, width, height, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame;
+    // 立即提交命令，否则 fence 可能一直停在驱动的命令队列里
+    glFlush();
+
+    next = (next + 1) % slots.size();
+    pending++;
+}
+
+void FrameReadback::poll(const Callback &onReady)
+{
+    while (pending > 0 && complete(slots[oldest], false, onReady))
+    {
+    }
+}
+
+void FrameReadback::flush(const Callback &onReady)
+{
+    while (pending > 0)
+        complete(slots[oldest], true, onReady);
+}
+
+bool FrameReadback::complete(Slot &slot, bool wait, const Callback &onReady)
+{
+    GLsync sync = (GLsync)slot.fence;
+    GLenum status = glClientWaitSync(sync, 0, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    glDeleteSync(sync);
+    slot.fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const unsigned char *pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        onReady(slot.frame, pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.frame = -1;
+    oldest = (oldest + 1) % slots.size();
+    pending--;
+    return true;
+}
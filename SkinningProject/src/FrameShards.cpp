@@ -0,0 +1,104 @@
+#include "FrameShards.h"
+#include "TaskScheduler.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+std::vector<FrameRange> FrameShards::split(int totalFrames, int shards)
+{
+    std::vector<FrameRange> ranges;
+    if (totalFrames <= 0)
+        return ranges;
+    if (shards > totalFrames)
+        shards = totalFrames;
+    if (shards < 1)
+        shards = 1;
+
+    int base = totalFrames / shards, extra = totalFrames % shards;
+    int begin = 0;
+    for (int s = 0; s < shards; s++)
+    {
+        int end = begin + base + (s < extra ? 1 : 0);
+        ranges.push_back({begin, end});
+        begin = end;
+    }
+    return ranges;
+}
+
+#ifndef _WIN32
+
+bool FrameShards::isSupported()
+{
+    return true;
+}
+
+int FrameShards::run(const std::vector<FrameRange> &ranges,
+                     const std::function<int(int shard, const FrameRange &range)> &worker)
+{
+    // 先清空缓冲，否则父进程缓冲区里的日志会在每个子进程中再输出一遍
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    // 子进程只继承调用 fork 的线程：先让调度器的工作线程退出，子进程里用到时再重建
+    TaskScheduler::shutdown();
+
+    std::vector<pid_t> children;
+    int failures = 0;
+    for (size_t s = 0; s < ranges.size(); s++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int code = worker((int)s, ranges[s]);
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(nullptr);
+            // 子进程不执行父进程注册的退出处理和静态析构
+            _exit(code == 0 ? 0 : 1);
+        }
+        if (pid < 0)
+        {
+            std::cerr << "Failed to fork shard " << s << ": " << std::strerror(errno) << std::endl;
+            failures++;
+            continue;
+        }
+        children.push_back(pid);
+    }
+
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "Shard process " << pid << " failed" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+#else
+
+bool FrameShards::isSupported()
+{
+    return false;
+}
+
+int FrameShards::run(const std::vector<FrameRange> &ranges,
+                     const std::function<int(int shard, const FrameRange &range)> &)
+{
+    std::cerr << "Frame sharding requires fork() and is not supported on this platform" << std::endl;
+    return (int)ranges.size();
+}
+
+#endif
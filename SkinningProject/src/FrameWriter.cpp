@@ -0,0 +1,103 @@
+#include "FrameWriter.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+FrameWriter::FrameWriter(const std::string &dir, Format fmt, int w, int h, int maxQueued)
+    : directory(dir), pattern(dir + (fmt == Format::PNG ? "/frame_%05d.png" : "/frame_%05d.ppm")), format(fmt),
+      width(w), height(h)
+{
+    if (maxQueued < 1)
+        maxQueued = 1;
+
+    // 缓冲池在启动时一次分配好，之后在渲染线程和编码任务之间循环使用
+    freeBuffers.resize(maxQueued);
+    for (auto &buffer : freeBuffers)
+        buffer.resize((size_t)width * height * 3);
+    MemoryStats::set(MemoryCategory::FrameBuffers, "Frame writer pool", freeBuffers.size() * width * height * 3);
+}
+
+FrameWriter::~FrameWriter()
+{
+    finish();
+    MemoryStats::set(MemoryCategory::FrameBuffers, "Frame writer pool", 0);
+}
+
+std::string FrameWriter::filename(int frame) const
+{
+    std::ostringstream name;
+    name << directory << "/frame_" << std::setfill('0') << std::setw(5) << frame
+         << (format == Format::PNG ? ".png" : ".ppm");
+    return name.str();
+}
+
+const char *FrameWriter::describe() const
+{
+    return pattern.c_str();
+}
+
+void FrameWriter::writeFrame(int frame, const unsigned char *pixels)
+{
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    std::vector<unsigned char> buffer;
+    for (;;)
+    {
+        while (!pending.empty() && pending.front()->done())
+            pending.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeBuffers.empty())
+            {
+                buffer.swap(freeBuffers.back());
+                freeBuffers.pop_back();
+                break;
+            }
+        }
+        // 反压：没有空闲缓冲时等最早的一帧写完（编码在 IO 线程上，这里只是睡眠等待）
+        scheduler.wait(pending.front());
+    }
+
+    std::copy(pixels, pixels + buffer.size(), buffer.begin());
+
+    pending.push_back(scheduler.submit([this, frame, pixels = std::move(buffer)]() mutable
+                                       {
+                                           encode(frame, pixels);
+                                           std::lock_guard<std::mutex> lock(mutex);
+                                           freeBuffers.push_back(std::move(pixels));
+                                       },
+                                       {}, TaskKind::IO));
+}
+
+void FrameWriter::finish()
+{
+    for (const TaskRef &task : pending)
+        TaskScheduler::instance().wait(task);
+    pending.clear();
+}
+
+void FrameWriter::encode(int frame, const std::vector<unsigned char> &pixels) const
+{
+    PROFILE_SCOPE("Encode frame");
+    const std::string name = filename(frame);
+    if (format == Format::PNG)
+    {
+        if (!stbi_write_png(name.c_str(), width, height, 3, pixels.data(), width * 3))
+            std::cerr << "Failed to write " << name << std::endl;
+        return;
+    }
+
+    // 保存为PPM格式（简单格式，可以用FFmpeg转换成视频）
+    std::ofstream file(name, std::ios::binary);
+    file << "P6\n"
+         << width << " " << height << "\n255\n";
+    file.write((const char *)pixels.data(), (std::streamsize)pixels.size());
+    if (!file)
+        std::cerr << "Failed to write " << name << std::endl;
+}
@@ -1,4 +1,6 @@
 #include "HeatSkinning.h"
+#include "Parallel.h"
+#include "Profiler.h"
 #include <cmath>
 #include <algorithm>
 
@@ -35,108 +37,134 @@ static bool isLegBone(int i)
     return (i == 149 || i == 150 || i == 154 || i == 155); // thigh.L, shin.L, thigh.R, shin.R
 }
 
-void HeatSkinning::computeWeights(Mesh &mesh, const Skeleton &skeleton)
+// 单个顶点的权重：heat 是调用者提供的长度为骨骼数的临时缓冲，在同一线程的顶点间复用
+static void computeVertexWeights(Vertex &v, const Skeleton &skeleton, float centerX, std::vector<float> &heat)
 {
-    const int B = skeleton.bones.size();
-    const float centerX = skeleton.bones[147].restMatrix[3].x;
+    const int B = (int)heat.size();
+    std::fill(heat.begin(), heat.end(), 0.0f);
 
-    for (auto &v : mesh.vertices)
+    for (int i = 0; i < B; i++)
     {
-        std::vector<float> heat(B, 0.0f);
+        // 1. 核心骨骼分类
+        bool isSpine = (i <= 6); // 包含所有 spine 链
+        bool isPelvis = (i == 147 || i == 148);
+        bool isThigh = (i == 149 || i == 154);
+        bool isShin = (i == 150 || i == 155);
+
+        // 2. 检测脚部相关骨骼 (151-153 左, 156-158 右)
+        bool isLeftFoot = (i >= 151 && i <= 153);
+        bool isRightFoot = (i >= 156 && i <= 158);
+
+        // 3. 只有躯干和腿部骨骼参与计算，其他的全部跳过
+        if (!isSpine && !isPelvis && !isThigh && !isShin && !isLeftFoot && !isRightFoot)
+            continue;
 
-        for (int i = 0; i < B; i++)
+        // 4. 左右隔离：左腿顶点不看右腿骨骼，反之亦然
+        if (v.position.x < centerX - 0.1f && (i == 154 || i == 155 || isRightFoot))
+            continue;
+        if (v.position.x > centerX + 0.1f && (i == 149 || i == 150 || isLeftFoot))
+            continue;
+
+        float d = distanceToBoneSegment(v.position, skeleton, i);
+        float falloff = 0.1f;
+        float h = std::exp(-(d * d) / falloff);
+
+        // 5. 【关键点】权重重定向：如果算出来是脚的权重，直接加给小腿
+        if (isLeftFoot)
         {
-            // 1. 核心骨骼分类
-            bool isSpine = (i <= 6); // 包含所有 spine 链
-            bool isPelvis = (i == 147 || i == 148);
-            bool isThigh = (i == 149 || i == 154);
-            bool isShin = (i == 150 || i == 155);
-
-            // 2. 检测脚部相关骨骼 (151-153 左, 156-158 右)
-            bool isLeftFoot = (i >= 151 && i <= 153);
-            bool isRightFoot = (i >= 156 && i <= 158);
-
-            // 3. 只有躯干和腿部骨骼参与计算，其他的全部跳过
-            if (!isSpine && !isPelvis && !isThigh && !isShin && !isLeftFoot && !isRightFoot)
-                continue;
-
-            // 4. 左右隔离：左腿顶点不看右腿骨骼，反之亦然
-            if (v.position.x < centerX - 0.1f && (i == 154 || i == 155 || isRightFoot))
-                continue;
-            if (v.position.x > centerX + 0.1f && (i == 149 || i == 150 || isLeftFoot))
-                continue;
-
-            float d = distanceToBoneSegment(v.position, skeleton, i);
-            float falloff = 0.1f;
-            float h = std::exp(-(d * d) / falloff);
-
-            // 5. 【关键点】权重重定向：如果算出来是脚的权重，直接加给小腿
-            if (isLeftFoot)
-            {
-                heat[150] += h * 0.5f; // 150 是 shin.L
-            }
-            else if (isRightFoot)
-            {
-                heat[155] += h * 0.5f; // 155 是 shin.R
-            }
-            else
-            {
-                // 正常的权重分配
-                if (isSpine || isPelvis)
-                    h *= 2.0f; // 增强躯干拉力
-                heat[i] += h;
-            }
+            heat[150] += h * 0.5f; // 150 是 shin.L
+        }
+        else if (isRightFoot)
+        {
+            heat[155] += h * 0.5f; // 155 是 shin.R
         }
+        else
+        {
+            // 正常的权重分配
+            if (isSpine || isPelvis)
+                h *= 2.0f; // 增强躯干拉力
+            heat[i] += h;
+        }
+    }
 
-        // --- 归一化与选取最大 4 个权重 ---
-        float sum = 0.0f;
-        for (float h : heat)
-            sum += h;
+    // --- 归一化与选取最大 4 个权重 ---
+    float sum = 0.0f;
+    for (float h : heat)
+        sum += h;
 
-        // 如果该顶点距离所有核心骨骼都太远，强制绑定到最近的 spine 或 pelvis
-        if (sum < 1e-6f)
+    // 如果该顶点距离所有核心骨骼都太远，强制绑定到最近的 spine 或 pelvis
+    if (sum < 1e-6f)
+    {
+        v.boneIDs[0] = 0;
+        v.weights[0] = 1.0f;
+        for (int k = 1; k < 4; k++)
         {
-            v.boneIDs[0] = 0;
-            v.weights[0] = 1.0f;
-            for (int k = 1; k < 4; k++)
-            {
-                v.boneIDs[k] = 0;
-                v.weights[k] = 0.0f;
-            }
-            continue;
+            v.boneIDs[k] = 0;
+            v.weights[k] = 0.0f;
         }
+        return;
+    }
 
-        for (int k = 0; k < 4; k++)
+    for (int k = 0; k < 4; k++)
+    {
+        int best = -1;
+        float maxv = -1.0f;
+        for (int i = 0; i < B; i++)
         {
-            int best = -1;
-            float maxv = -1.0f;
-            for (int i = 0; i < B; i++)
-            {
-                if (heat[i] > maxv)
-                {
-                    maxv = heat[i];
-                    best = i;
-                }
-            }
-            if (best >= 0 && maxv > 1e-9f)
+            if (heat[i] > maxv)
             {
-                v.boneIDs[k] = best;
-                v.weights[k] = maxv;
-                heat[best] = -1.0f;
-            }
-            else
-            {
-                v.boneIDs[k] = 0;
-                v.weights[k] = 0.0f;
+                maxv = heat[i];
+                best = i;
             }
         }
-
-        // 最终归一化，确保顶点受力平衡
-        float finalSum = v.weights[0] + v.weights[1] + v.weights[2] + v.weights[3];
-        if (finalSum > 0)
+        if (best >= 0 && maxv > 1e-9f)
         {
-            for (int k = 0; k < 4; k++)
-                v.weights[k] /= finalSum;
+            v.boneIDs[k] = best;
+            v.weights[k] = maxv;
+            heat[best] = -1.0f;
         }
+        else
+        {
+            v.boneIDs[k] = 0;
+            v.weights[k] = 0.0f;
+        }
+    }
+
+    // 最终归一化，确保顶点受力平衡
+    float finalSum = v.weights[0] + v.weights[1] + v.weights[2] + v.weights[3];
+    if (finalSum > 0)
+    {
+        for (int k = 0; k < 4; k++)
+            v.weights[k] /= finalSum;
     }
 }
+
+bool HeatSkinning::supports(const Skeleton &skeleton)
+{
+    static const char *names[] = {"pelvis.L", "pelvis.R", "thigh.L", "shin.L", "foot.L", "toe.L",
+                                  "heel.02.L", "thigh.R", "shin.R", "foot.R", "toe.R", "heel.02.R"};
+    const size_t first = 147;
+    if (skeleton.bones.size() < first + sizeof(names) / sizeof(names[0]))
+        return false;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (skeleton.bones[first + i].name != names[i])
+            return false;
+    }
+    return true;
+}
+
+void HeatSkinning::computeWeights(Mesh &mesh, const Skeleton &skeleton)
+{
+    PROFILE_SCOPE("HeatSkinning::computeWeights");
+    const int B = skeleton.bones.size();
+    const float centerX = skeleton.bones[147].restMatrix[3].x;
+
+    // 顶点之间相互独立，按块并行
+    parallelFor(0, mesh.vertices.size(), 1024, [&](size_t b, size_t e)
+                {
+                    std::vector<float> heat(B);
+                    for (size_t i = b; i < e; i++)
+                        computeVertexWeights(mesh.vertices[i], skeleton, centerX, heat);
+                });
+}
@@ -0,0 +1,171 @@
+#include "MemoryStats.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    const int CPU_CATEGORIES = (int)MemoryCategory::Count;
+    const int GPU_CATEGORIES = (int)GpuMemoryCategory::Count;
+
+    // CPU 分类在前，GPU 分类接在后面
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<std::string, size_t> entries[CPU_CATEGORIES + GPU_CATEGORIES];
+        MemoryUsage categories[CPU_CATEGORIES + GPU_CATEGORIES] = {};
+        MemoryUsage cpu = {0, 0};
+        MemoryUsage gpu = {0, 0};
+    };
+
+    // 全局对象（例如 FrameReadback）在析构时登记 0，可能晚于函数内静态对象的析构：登记表有意不释放
+    Registry &registry()
+    {
+        static Registry *r = new Registry;
+        return *r;
+    }
+
+    void update(int slot, bool gpu, const std::string &name, size_t bytes)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        size_t &entry = r.entries[slot][name];
+        MemoryUsage &category = r.categories[slot];
+        MemoryUsage &total = gpu ? r.gpu : r.cpu;
+
+        category.current = category.current - entry + bytes;
+        total.current = total.current - entry + bytes;
+        category.peak = std::max(category.peak, category.current);
+        total.peak = std::max(total.peak, total.current);
+        entry = bytes;
+    }
+
+    void printCategory(std::ostream &out, const char *label, const MemoryUsage &usage,
+                       const std::map<std::string, size_t> &entries)
+    {
+        if (usage.peak == 0)
+            return;
+        out << "    " << std::left << std::setw(28) << label << std::right << std::setw(11) << MemoryStats::format(usage.current)
+            << "  (peak " << MemoryStats::format(usage.peak) << ")" << std::endl;
+        for (const auto &entry : entries)
+        {
+            if (entry.second > 0)
+                out << "      " << std::left << std::setw(26) << entry.first << std::right << std::setw(11)
+                    << MemoryStats::format(entry.second) << std::endl;
+        }
+    }
+}
+
+std::string MemoryStats::format(size_t bytes)
+{
+    char text[32];
+    if (bytes >= (size_t)1 << 20)
+        std::snprintf(text, sizeof(text), "%.2f MB", bytes / 1048576.0);
+    else if (bytes >= 1024)
+        std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    else
+        std::snprintf(text, sizeof(text), "%zu B", bytes);
+    return text;
+}
+
+void MemoryStats::set(MemoryCategory category, const std::string &name, size_t bytes)
+{
+    update((int)category, false, name, bytes);
+}
+
+void MemoryStats::set(GpuMemoryCategory category, const std::string &name, size_t bytes)
+{
+    update(CPU_CATEGORIES + (int)category, true, name, bytes);
+}
+
+MemoryUsage MemoryStats::usage(MemoryCategory category)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.categories[(int)category];
+}
+
+MemoryUsage MemoryStats::usage(GpuMemoryCategory category)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.categories[CPU_CATEGORIES + (int)category];
+}
+
+MemoryUsage MemoryStats::cpuTotal()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.cpu;
+}
+
+MemoryUsage MemoryStats::gpuTotal()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.gpu;
+}
+
+MemoryUsage MemoryStats::residentSet()
+{
+    MemoryUsage usage = {0, 0};
+#ifdef __linux__
+    FILE *status = std::fopen("/proc/self/status", "r");
+    if (!status)
+        return usage;
+    char line[256];
+    while (std::fgets(line, sizeof(line), status))
+    {
+        unsigned long kb = 0;
+        if (std::sscanf(line, "VmRSS: %lu kB", &kb) == 1)
+            usage.current = (size_t)kb * 1024;
+        else if (std::sscanf(line, "VmHWM: %lu kB", &kb) == 1)
+            usage.peak = (size_t)kb * 1024;
+    }
+    std::fclose(status);
+#endif
+    return usage;
+}
+
+const char *MemoryStats::name(MemoryCategory category)
+{
+    static const char *names[CPU_CATEGORIES] = {"mesh vertices", "mesh indices", "weights", "skeleton",
+                                                "animation", "frame buffers", "caches"};
+    return names[(int)category];
+}
+
+const char *MemoryStats::name(GpuMemoryCategory category)
+{
+    static const char *names[GPU_CATEGORIES] = {"vertex buffer", "index buffer", "instance buffer",
+                                                "bone palette", "framebuffer", "pixel buffers"};
+    return names[(int)category];
+}
+
+void MemoryStats::printReport(std::ostream &out)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << "Memory footprint:" << std::endl;
+    out << "  CPU " << MemoryStats::format(r.cpu.current) << " (peak " << MemoryStats::format(r.cpu.peak) << ")" << std::endl;
+    for (int c = 0; c < CPU_CATEGORIES; c++)
+        printCategory(out, name((MemoryCategory)c), r.categories[c], r.entries[c]);
+    out << "  GPU " << MemoryStats::format(r.gpu.current) << " (peak " << MemoryStats::format(r.gpu.peak) << ")" << std::endl;
+    for (int c = 0; c < GPU_CATEGORIES; c++)
+        printCategory(out, name((GpuMemoryCategory)c), r.categories[CPU_CATEGORIES + c], r.entries[CPU_CATEGORIES + c]);
+
+    MemoryUsage rss = residentSet();
+    if (rss.current > 0)
+        out << "  Process RSS " << MemoryStats::format(rss.current) << " (peak " << MemoryStats::format(rss.peak) << ")" << std::endl;
+}
+
+void MemoryStats::printPeak(std::ostream &out)
+{
+    MemoryUsage cpu = cpuTotal(), gpu = gpuTotal(), rss = residentSet();
+    out << "Peak memory: " << MemoryStats::format(cpu.peak) << " CPU tracked, " << MemoryStats::format(gpu.peak) << " GPU";
+    if (rss.peak > 0)
+        out << ", " << MemoryStats::format(rss.peak) << " process RSS";
+    out << std::endl;
+}
@@ -1,72 +1,170 @@
 #include "Mesh.h"
+#include "Arena.h"
+#include "Profiler.h"
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+    // OBJ 逐行解析的游标：只在当前行内移动，不会越过换行
+    struct LineCursor
+    {
+        const char *p;
+        const char *end; // 行尾（换行符或文件末尾）
+
+        void skipSpaces()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+                p++;
+        }
+
+        // 下一个以空白分隔的词
+        std::string_view token()
+        {
+            skipSpaces();
+            const char *start = p;
+            while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+                p++;
+            return std::string_view(start, (size_t)(p - start));
+        }
+
+        // 与 istream >> float 相同，由 strtof 转换；行内没有数字时返回 0
+        float number()
+        {
+            skipSpaces();
+            if (p >= end)
+                return 0.0f;
+            char *next = nullptr;
+            float value = std::strtof(p, &next);
+            p = next > p && next <= end ? next : end;
+            return value;
+        }
+    };
+
+    // 面角 "v"、"v/vt"、"v//vn" 或 "v/vt/vn"，返回从 0 开始的位置和法线索引（没有时为 -1）
+    void parseCorner(std::string_view corner, int &position, int &normal)
+    {
+        const char *p = corner.data(), *end = p + corner.size();
+        auto integer = [&]() -> int
+        {
+            bool negative = p < end && *p == '-';
+            if (negative || (p < end && *p == '+'))
+                p++;
+            int value = 0;
+            bool digits = false;
+            for (; p < end && *p >= '0' && *p <= '9'; p++, digits = true)
+                value = value * 10 + (*p - '0');
+            return digits ? (negative ? -value : value) : 0;
+        };
+
+        position = integer() - 1; // OBJ索引从1开始
+        normal = -1;
+        while (p < end && *p != '/')
+            p++;
+        if (p == end)
+            return;
+        p++;
+        while (p < end && *p != '/') // 纹理坐标不使用
+            p++;
+        if (p == end)
+            return;
+        p++;
+        if (p < end)
+            normal = integer() - 1;
+    }
+
+    const char *lineEnd(const char *p, const char *end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', (size_t)(end - p)));
+        return newline ? newline : end;
+    }
+}
 
 bool Mesh::loadOBJ(const std::string &path)
 {
-    std::ifstream file(path);
+    PROFILE_SCOPE("Mesh::loadOBJ");
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
     if (!file.is_open())
     {
         std::cerr << "无法打开文件: " << path << std::endl;
         return false;
     }
 
-    std::vector<glm::vec3> temp_positions;
-    std::vector<glm::vec3> temp_normals;
-    std::vector<glm::vec2> temp_texcoords;
-    
-    std::string line;
-    while (std::getline(file, line))
+    // 加载期间的临时数据（文件内容、位置和法线表）都放在内存池里，函数返回时一次释放
+    Arena arena;
+    const size_t size = (size_t)file.tellg();
+    // 多留一个字节写入 '\0'：strtof 从行内开始读，最后一行没有换行时不能越过文件内容
+    char *text = arena.allocateArray<char>(size + 1);
+    file.seekg(0);
+    if (!file.read(text, (std::streamsize)size))
+    {
+        std::cerr << "读取文件失败: " << path << std::endl;
+        return false;
+    }
+    text[size] = '\0';
+    const char *const textEnd = text + size;
+
+    // 第一遍：统计位置、法线和面角的数量，临时表和最终数组都只分配一次
+    size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+    for (const char *p = text; p < textEnd;)
     {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
+        LineCursor line{p, lineEnd(p, textEnd)};
+        std::string_view type = line.token();
+        if (type == "v")
+            positionCount++;
+        else if (type == "vn")
+            normalCount++;
+        else if (type == "f")
+            while (!line.token().empty())
+                cornerCount++;
+        p = line.end + 1;
+    }
+
+    glm::vec3 *positions = arena.allocateArray<glm::vec3>(positionCount);
+    glm::vec3 *normals = arena.allocateArray<glm::vec3>(normalCount);
+    vertices.reserve(vertices.size() + cornerCount);
+    indices.reserve(indices.size() + cornerCount);
 
+    // 第二遍：直接在文件内容上解析，不再为每行、每个面角构造字符串
+    size_t positionsRead = 0, normalsRead = 0;
+    for (const char *p = text; p < textEnd;)
+    {
+        LineCursor line{p, lineEnd(p, textEnd)};
+        std::string_view type = line.token();
         if (type == "v")
         {
-            glm::vec3 pos;
-            iss >> pos.x >> pos.y >> pos.z;
-            temp_positions.push_back(pos);
+            glm::vec3 &pos = positions[positionsRead++];
+            pos.x = line.number();
+            pos.y = line.number();
+            pos.z = line.number();
         }
         else if (type == "vn")
         {
-            glm::vec3 norm;
-            iss >> norm.x >> norm.y >> norm.z;
-            temp_normals.push_back(norm);
-        }
-        else if (type == "vt")
-        {
-            glm::vec2 tex;
-            iss >> tex.x >> tex.y;
-            temp_texcoords.push_back(tex);
+            glm::vec3 &norm = normals[normalsRead++];
+            norm.x = line.number();
+            norm.y = line.number();
+            norm.z = line.number();
         }
         else if (type == "f")
         {
-            std::vector<std::string> tokens;
-            std::string token;
-            while (iss >> token)
-                tokens.push_back(token);
-
             // 处理面，支持 v/vt/vn 格式
-            for (const auto &t : tokens)
+            for (std::string_view corner = line.token(); !corner.empty(); corner = line.token())
             {
-                std::istringstream tokenStream(t);
-                std::string v_str, vt_str, vn_str;
-                
-                std::getline(tokenStream, v_str, '/');
-                std::getline(tokenStream, vt_str, '/');
-                std::getline(tokenStream, vn_str, '/');
-
-                int v_idx = std::stoi(v_str) - 1; // OBJ索引从1开始
-                int vn_idx = vn_str.empty() ? -1 : std::stoi(vn_str) - 1;
+                int v_idx, vn_idx;
+                parseCorner(corner, v_idx, vn_idx);
 
                 Vertex vertex;
-                if (v_idx >= 0 && v_idx < (int)temp_positions.size())
-                    vertex.position = temp_positions[v_idx];
-                
-                if (vn_idx >= 0 && vn_idx < (int)temp_normals.size())
-                    vertex.normal = temp_normals[vn_idx];
+                if (v_idx >= 0 && v_idx < (int)positionsRead)
+                    vertex.position = positions[v_idx];
+
+                if (vn_idx >= 0 && vn_idx < (int)normalsRead)
+                    vertex.normal = normals[vn_idx];
                 else
                     vertex.normal = glm::vec3(0, 1, 0); // 默认法线
 
@@ -74,10 +172,11 @@ bool Mesh::loadOBJ(const std::string &path)
                 indices.push_back(vertices.size() - 1);
             }
         }
+        p = line.end + 1;
     }
 
     // 如果没有法线，计算面法线
-    if (temp_normals.empty())
+    if (normalCount == 0)
     {
         for (size_t i = 0; i < indices.size(); i += 3)
         {
@@ -105,3 +204,174 @@ bool Mesh::loadOBJ(const std::string &path)
     return true;
 }
 
+MeshAdjacency Mesh::buildAdjacency() const
+{
+    MeshAdjacency adj;
+
+    // 按位置焊接：位置完全相同的顶点视为同一节点
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            // 加 0 把 -0.0f 变成 0.0f：两者按 == 相等，散列也必须相同
+            const glm::vec3 canonical = p + glm::vec3(0.0f);
+            uint32_t bits[3];
+            std::memcpy(bits, &canonical[0], sizeof(bits));
+            return ((size_t)bits[0] * 73856093u) ^ ((size_t)bits[1] * 19349663u) ^ ((size_t)bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> nodeOf;
+    nodeOf.reserve(vertices.size());
+
+    adj.vertexToNode.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        auto it = nodeOf.emplace(vertices[i].position, (unsigned int)nodeOf.size()).first;
+        adj.vertexToNode[i] = it->second;
+    }
+    const size_t nodes = nodeOf.size();
+
+    // 收集无向边（每条边两个方向各一次），排序去重后转成 CSR
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(indices.size() * 2);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = adj.vertexToNode[indices[i + k]];
+            unsigned int b = adj.vertexToNode[indices[i + (k + 1) % 3]];
+            if (a == b)
+                continue;
+            edges.emplace_back(a, b);
+            edges.emplace_back(b, a);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    adj.offsets.assign(nodes + 1, 0);
+    for (const auto &e : edges)
+        adj.offsets[e.first + 1]++;
+    for (size_t i = 0; i < nodes; i++)
+        adj.offsets[i + 1] += adj.offsets[i];
+
+    adj.neighbors.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); i++)
+        adj.neighbors[i] = edges[i].second;
+
+    return adj;
+}
+
+int Mesh::dominantBone(size_t t) const
+{
+    int bones[12];
+    float sums[12];
+    int n = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        const Vertex &v = vertices[indices[3 * t + c]];
+        for (int k = 0; k < 4; k++)
+        {
+            if (v.boneIDs[k] < 0 || v.weights[k] <= 0.0f)
+                continue;
+            int j = 0;
+            while (j < n && bones[j] != v.boneIDs[k])
+                j++;
+            if (j == n)
+            {
+                bones[n] = v.boneIDs[k];
+                sums[n++] = 0.0f;
+            }
+            sums[j] += v.weights[k];
+        }
+    }
+    int best = -1;
+    for (int j = 0; j < n; j++)
+    {
+        if (best < 0 || sums[j] > sums[best])
+            best = j;
+    }
+    return best >= 0 ? bones[best] : -1;
+}
+
+std::vector<DrawRange> Mesh::sortByInfluenceCount(const std::vector<int> &bonePartition)
+{
+    PROFILE_SCOPE("Mesh::sortByInfluenceCount");
+    static const int VARIANTS[3] = {1, 2, 4};
+    int partitions = 1;
+    for (int p : bonePartition)
+        partitions = std::max(partitions, p + 1);
+
+    // 1. 顶点影响降序排列，无效影响清零，统计有效影响数
+    std::vector<unsigned char> vertexInfluences(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vertex &v = vertices[i];
+        std::pair<float, int> inf[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bool valid = v.boneIDs[k] >= 0 && v.weights[k] > 0.0f;
+            inf[k] = valid ? std::make_pair(v.weights[k], v.boneIDs[k]) : std::make_pair(0.0f, 0);
+        }
+        std::sort(inf, inf + 4, [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+                  { return a.first > b.first; });
+
+        int count = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            v.weights[k] = inf[k].first;
+            v.boneIDs[k] = inf[k].second;
+            if (inf[k].first > 0.0f)
+                count++;
+        }
+        vertexInfluences[i] = (unsigned char)count;
+    }
+
+    // 2. 三角形按（最大影响数，骨骼分组）分组（稳定的计数排序）。
+    //    分组取三个顶点权重之和最大的骨骼所在的组；没有权重的三角形归入第 0 组
+    const size_t triCount = indices.size() / 3;
+    const size_t groupCount = 3 * (size_t)partitions;
+    std::vector<unsigned int> triGroup(triCount);
+    std::vector<size_t> groupSize(groupCount, 0);
+    for (size_t t = 0; t < triCount; t++)
+    {
+        int count = std::max({vertexInfluences[indices[3 * t]],
+                              vertexInfluences[indices[3 * t + 1]],
+                              vertexInfluences[indices[3 * t + 2]]});
+        int variant = count <= 1 ? 0 : (count == 2 ? 1 : 2);
+
+        int partition = 0;
+        if (partitions > 1)
+        {
+            int bone = dominantBone(t);
+            if (bone >= 0 && bone < (int)bonePartition.size())
+                partition = bonePartition[bone];
+        }
+
+        unsigned int group = (unsigned int)(variant * partitions + partition);
+        triGroup[t] = group;
+        groupSize[group]++;
+    }
+
+    std::vector<size_t> groupStart(groupCount, 0);
+    for (size_t g = 1; g < groupCount; g++)
+        groupStart[g] = groupStart[g - 1] + groupSize[g - 1];
+    std::vector<unsigned int> sorted(triCount * 3);
+    std::vector<size_t> cursor = groupStart;
+    for (size_t t = 0; t < triCount; t++)
+    {
+        size_t dst = cursor[triGroup[t]]++;
+        for (int k = 0; k < 3; k++)
+            sorted[3 * dst + k] = indices[3 * t + k];
+    }
+    indices.swap(sorted);
+
+    std::vector<DrawRange> ranges;
+    for (size_t g = 0; g < groupCount; g++)
+    {
+        if (groupSize[g] > 0)
+            ranges.push_back({VARIANTS[g / partitions], (unsigned int)(groupStart[g] * 3), (unsigned int)(groupSize[g] * 3),
+                              (int)(g % partitions)});
+    }
+    return ranges;
+}
@@ -0,0 +1,292 @@
+#include "Profiler.h"
+#include "glad/glad.h"
+#include "json.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace
+{
+    struct Event
+    {
+        const char *name;
+        uint64_t start, end;
+        int frame;
+    };
+
+    // 一个线程的事件缓冲，只有持有它的线程追加。调度器的工作线程常驻，但调度器重建（修改线程数、分片 fork）
+    // 时会换一批线程：线程退出时缓冲还回空闲列表给之后的线程复用，事件保留到导出
+    struct ThreadBuffer
+    {
+        int tid;
+        std::vector<Event> events;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex; // 只在线程第一次记录和退出时使用
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::vector<ThreadBuffer *> freeBuffers;
+        std::vector<Event> gpuEvents;
+        uint64_t epoch = 0;
+    };
+
+    Registry &registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    std::atomic<int> currentFrame(-1);
+
+    const int GPU_TID = 1000;
+    const size_t EVENT_CHUNK = 4096;
+
+    struct ThreadSlot
+    {
+        ThreadBuffer *buffer = nullptr;
+
+        ~ThreadSlot()
+        {
+            if (!buffer)
+                return;
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.freeBuffers.push_back(buffer);
+        }
+
+        ThreadBuffer *get()
+        {
+            if (buffer)
+                return buffer;
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            if (!r.freeBuffers.empty())
+            {
+                buffer = r.freeBuffers.back();
+                r.freeBuffers.pop_back();
+            }
+            else
+            {
+                r.buffers.push_back(std::make_unique<ThreadBuffer>());
+                buffer = r.buffers.back().get();
+                buffer->tid = (int)r.buffers.size() - 1;
+            }
+            return buffer;
+        }
+    };
+
+    thread_local ThreadSlot threadSlot;
+}
+
+void Profiler::setEnabled(bool enable)
+{
+    if (enable && registry().epoch == 0)
+        registry().epoch = now();
+    active = enable;
+}
+
+uint64_t Profiler::now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Profiler::setFrame(int frame)
+{
+    currentFrame.store(frame, std::memory_order_relaxed);
+}
+
+int Profiler::frame()
+{
+    return currentFrame.load(std::memory_order_relaxed);
+}
+
+void Profiler::record(const char *name, uint64_t start, uint64_t end)
+{
+    ThreadBuffer *buffer = threadSlot.get();
+    if (buffer->events.size() == buffer->events.capacity())
+        buffer->events.reserve(buffer->events.size() + EVENT_CHUNK);
+    buffer->events.push_back({name, start, end, frame()});
+}
+
+void Profiler::recordGpu(const char *name, uint64_t start, uint64_t end, int frame)
+{
+    registry().gpuEvents.push_back({name, start, end, frame});
+}
+
+bool Profiler::writeChromeTrace(const std::string &path)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    const int pid = (int)getpid();
+    json events = json::array();
+
+    auto threadName = [&](int tid, const std::string &name)
+    {
+        events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", tid}, {"args", {{"name", name}}}});
+    };
+    auto addEvents = [&](int tid, const std::vector<Event> &list, const char *category)
+    {
+        for (const Event &e : list)
+        {
+            json event = {{"name", e.name},
+                          {"cat", category},
+                          {"ph", "X"},
+                          {"pid", pid},
+                          {"tid", tid},
+                          {"ts", (double)(int64_t)(e.start - r.epoch) / 1000.0},
+                          {"dur", (double)(e.end - e.start) / 1000.0}};
+            if (e.frame >= 0)
+                event["args"] = {{"frame", e.frame}};
+            events.push_back(std::move(event));
+        }
+    };
+
+    for (const auto &buffer : r.buffers)
+    {
+        threadName(buffer->tid, buffer->tid == 0 ? "main" : "worker " + std::to_string(buffer->tid));
+        addEvents(buffer->tid, buffer->events, "cpu");
+    }
+    if (!r.gpuEvents.empty())
+    {
+        threadName(GPU_TID, "GPU");
+        addEvents(GPU_TID, r.gpuEvents, "gpu");
+    }
+
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Failed to open trace file: " << path << std::endl;
+        return false;
+    }
+    out << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+    return (bool)out;
+}
+
+// --- GPU 时间戳查询 ---
+
+namespace
+{
+    struct GpuZone
+    {
+        const char *name;
+        int frame;
+        GLuint begin, end;
+        bool ended;
+    };
+
+    struct GpuState
+    {
+        bool ready = false;
+        int64_t offset = 0; // CPU 时钟 - GPU 时间戳
+        std::vector<GLuint> freeQueries;
+        std::deque<GpuZone> pending; // 按提交顺序，结果也按顺序可用
+        size_t firstZone = 0;        // pending.front() 的区间序号
+    };
+
+    GpuState gpu;
+
+    GLuint acquireQuery()
+    {
+        if (gpu.freeQueries.empty())
+        {
+            GLuint queries[16];
+            glGenQueries(16, queries);
+            gpu.freeQueries.assign(queries, queries + 16);
+        }
+        GLuint q = gpu.freeQueries.back();
+        gpu.freeQueries.pop_back();
+        return q;
+    }
+}
+
+bool GpuProfiler::create()
+{
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    gpu.offset = (int64_t)Profiler::now() - (int64_t)gpuTime;
+    gpu.ready = glGetError() == GL_NO_ERROR;
+    if (!gpu.ready)
+        std::cerr << "GL timestamp queries not available, GPU zones disabled" << std::endl;
+    return gpu.ready;
+}
+
+void GpuProfiler::collect(bool wait)
+{
+    while (!gpu.pending.empty())
+    {
+        GpuZone &zone = gpu.pending.front();
+        if (!zone.ended)
+            break;
+        if (!wait)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(zone.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+        }
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+        Profiler::recordGpu(zone.name, (uint64_t)((int64_t)begin + gpu.offset),
+                            (uint64_t)((int64_t)end + gpu.offset), zone.frame);
+
+        gpu.freeQueries.push_back(zone.begin);
+        gpu.freeQueries.push_back(zone.end);
+        gpu.pending.pop_front();
+        gpu.firstZone++;
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    if (!gpu.ready)
+        return;
+    collect(true);
+    for (const GpuZone &zone : gpu.pending)
+    {
+        gpu.freeQueries.push_back(zone.begin);
+        gpu.freeQueries.push_back(zone.end);
+    }
+    gpu.pending.clear();
+    if (!gpu.freeQueries.empty())
+        glDeleteQueries((GLsizei)gpu.freeQueries.size(), gpu.freeQueries.data());
+    gpu = GpuState();
+}
+
+int GpuProfiler::begin(const char *name)
+{
+    if (!gpu.ready || !Profiler::enabled())
+        return -1;
+    GpuZone zone = {name, Profiler::frame(), acquireQuery(), acquireQuery(), false};
+    glQueryCounter(zone.begin, GL_TIMESTAMP);
+    gpu.pending.push_back(zone);
+    return (int)(gpu.firstZone + gpu.pending.size() - 1);
+}
+
+void GpuProfiler::end(int zone)
+{
+    if (zone < 0)
+        return;
+    GpuZone &z = gpu.pending[(size_t)zone - gpu.firstZone];
+    glQueryCounter(z.end, GL_TIMESTAMP);
+    z.ended = true;
+}
@@ -0,0 +1,250 @@
+#include "RenderContext.h"
+#include "MemoryStats.h"
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+RenderContext::RenderContext()
+    : backend(ContextBackend::GLFW), width(0), height(0), window(nullptr),
+      eglDisplay(nullptr), eglContext(nullptr), eglSurface(nullptr),
+      fbo(0), colorBuffer(0), depthBuffer(0)
+{
+}
+
+RenderContext::~RenderContext()
+{
+    destroy();
+}
+
+bool RenderContext::hasEGL()
+{
+#ifdef HAS_EGL
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool RenderContext::create(ContextBackend requested, int w, int h)
+{
+    backend = requested;
+    width = w;
+    height = h;
+
+    bool ok = (backend == ContextBackend::EGL) ? createEGL() : createGLFW();
+    if (!ok)
+        return false;
+
+    if (!createFramebuffer())
+    {
+        destroy();
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    return true;
+}
+
+bool RenderContext::createGLFW()
+{
+    // 初始化GLFW
+    if (!glfwInit())
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // 隐藏窗口，因为我们只是渲染视频
+
+    window = glfwCreateWindow(width, height, "Skinning Animation", nullptr, nullptr);
+    if (!window)
+    {
+        std::cerr << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(window);
+
+    // 初始化GLAD
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RenderContext::createEGL()
+{
+#ifdef HAS_EGL
+    // 优先使用 Mesa 的 surfaceless 平台，完全不依赖窗口系统
+    EGLDisplay display = EGL_NO_DISPLAY;
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay && clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    eglDisplay = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    bool noConfig = extensions && std::strstr(extensions, "EGL_KHR_no_config_context");
+    bool surfaceless = extensions && std::strstr(extensions, "EGL_KHR_surfaceless_context");
+
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!noConfig || !surfaceless)
+    {
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_NONE};
+        EGLint count = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count == 0)
+        {
+            std::cerr << "Failed to choose EGL config" << std::endl;
+            return false;
+        }
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Failed to create EGL context (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
+    eglContext = context;
+
+    // 所有渲染都进 FBO，有 surfaceless 扩展时不需要任何表面
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!surfaceless)
+    {
+        const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        eglSurface = surface;
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cerr << "Failed to make EGL context current" << std::endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+
+    std::cout << "EGL " << major << "." << minor << ": " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+#else
+    std::cerr << "This build has no EGL support" << std::endl;
+    return false;
+#endif
+}
+
+bool RenderContext::createFramebuffer()
+{
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+        return false;
+    }
+    // RGBA8 颜色 + DEPTH24_STENCIL8，每个像素各 4 字节
+    MemoryStats::set(GpuMemoryCategory::Framebuffer, "Offscreen FBO", (size_t)width * height * 8);
+    return true;
+}
+
+void RenderContext::swapBuffers()
+{
+    if (!window)
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glfwSwapBuffers(window);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void RenderContext::pollEvents()
+{
+    if (window)
+        glfwPollEvents();
+}
+
+void RenderContext::destroy()
+{
+    if (fbo != 0)
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = colorBuffer = depthBuffer = 0;
+        MemoryStats::set(GpuMemoryCategory::Framebuffer, "Offscreen FBO", 0);
+    }
+
+    if (window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        window = nullptr;
+    }
+
+#ifdef HAS_EGL
+    if (eglDisplay)
+    {
+        eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglSurface)
+            eglDestroySurface((EGLDisplay)eglDisplay, (EGLSurface)eglSurface);
+        if (eglContext)
+            eglDestroyContext((EGLDisplay)eglDisplay, (EGLContext)eglContext);
+        eglTerminate((EGLDisplay)eglDisplay);
+    }
+#endif
+    eglDisplay = eglContext = eglSurface = nullptr;
+}
@@ -0,0 +1,281 @@
+#include "RigGenerator.h"
+#include "json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // 只用 mt19937 的原始输出：标准库的分布在不同实现上结果不同，会破坏跨平台的确定性
+    class Random
+    {
+    public:
+        explicit Random(unsigned int seed) : engine(seed) {}
+        float uniform() { return (engine() >> 8) * (1.0f / 16777216.0f); }
+        float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    // 任意一个与 d 垂直的单位向量
+    glm::vec3 perpendicular(const glm::vec3 &d)
+    {
+        glm::vec3 axis = std::abs(d.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        return glm::normalize(glm::cross(d, axis));
+    }
+
+    struct Limb
+    {
+        int parentBone;
+        glm::vec3 start;
+        glm::vec3 direction;
+        float length;
+        float radius;
+        int level;
+        size_t firstBone; // 在 boneList 中的骨骼区间
+        size_t boneCount;
+    };
+}
+
+RigParams RigParams::forBoneCount(size_t bones, size_t vertices, unsigned int seed)
+{
+    RigParams params;
+    params.fanout = 3;
+    params.seed = seed;
+    params.targetVertices = vertices;
+    params.maxBones = std::max<size_t>(1, bones);
+
+    // 层数从浅到深，直到每个肢体不超过 6 节骨骼
+    size_t limbs = 1, levelLimbs = 1;
+    for (params.depth = 0;; params.depth++)
+    {
+        params.bonesPerLimb = (int)((params.maxBones + limbs - 1) / limbs);
+        if (params.bonesPerLimb <= 6)
+            break;
+        levelLimbs *= params.fanout;
+        limbs += levelLimbs;
+    }
+    return params;
+}
+
+bool RigGenerator::generate(const RigParams &params)
+{
+    boneList.clear();
+    positions.clear();
+    normals.clear();
+    triangles.clear();
+    if (params.bonesPerLimb < 1 || params.fanout < 1 || params.depth < 0)
+    {
+        std::cerr << "Invalid rig parameters" << std::endl;
+        return false;
+    }
+
+    Random random(params.seed);
+    const size_t maxBones = params.maxBones > 0 ? params.maxBones : (size_t)-1;
+
+    // 1. 骨架：根肢体从原点沿 +y 向上（与场景相机一致），肢体按层序展开，
+    //    每个肢体是一条略微弯曲的骨骼链，末端分出子肢体
+    std::vector<Limb> limbs;
+    std::deque<Limb> queue;
+    queue.push_back({-1, glm::vec3(0.0f), glm::vec3(0, 1, 0), params.limbLength, params.limbRadius, 0, 0, 0});
+    while (!queue.empty() && boneList.size() < maxBones)
+    {
+        Limb limb = queue.front();
+        queue.pop_front();
+        limb.firstBone = boneList.size();
+
+        glm::vec3 head = limb.start, direction = limb.direction;
+        int parent = limb.parentBone;
+        const float boneLength = limb.length / params.bonesPerLimb;
+        for (int i = 0; i < params.bonesPerLimb && boneList.size() < maxBones; i++)
+        {
+            // 每节在随机方向上偏一点
+            glm::vec3 bend = perpendicular(direction);
+            float angle = random.uniform(0.0f, 2.0f * PI);
+            bend = bend * std::cos(angle) + glm::cross(direction, bend) * std::sin(angle);
+            direction = glm::normalize(direction + bend * random.uniform(0.0f, 0.15f));
+
+            GeneratedBone bone;
+            bone.name = "limb" + std::to_string(limbs.size()) + ".bone" + std::to_string(i);
+            bone.parent = parent;
+            bone.head = head;
+            bone.tail = head + direction * boneLength;
+            parent = (int)boneList.size();
+            head = bone.tail;
+            boneList.push_back(bone);
+        }
+        limb.boneCount = boneList.size() - limb.firstBone;
+        limbs.push_back(limb);
+
+        if (limb.level >= params.depth)
+            continue;
+
+        // 子肢体在末端沿圆锥方向均匀分开，方位和张角带一些随机扰动
+        glm::vec3 u = perpendicular(direction), v = glm::cross(direction, u);
+        float phase = random.uniform(0.0f, 2.0f * PI);
+        for (int c = 0; c < params.fanout; c++)
+        {
+            float azimuth = phase + 2.0f * PI * c / params.fanout + random.uniform(-0.3f, 0.3f);
+            float spread = random.uniform(0.6f, 1.2f);
+            glm::vec3 side = u * std::cos(azimuth) + v * std::sin(azimuth);
+            glm::vec3 childDirection = glm::normalize(direction * std::cos(spread) + side * std::sin(spread));
+            queue.push_back({parent, head, childDirection, limb.length * random.uniform(0.65f, 0.85f),
+                             limb.radius * random.uniform(0.55f, 0.7f), limb.level + 1, 0, 0});
+        }
+    }
+
+    // 2. 分辨率：三角形数约为 2 * segments * (骨骼数 * ringsPerBone + 肢体数)（管壁 + 两端封口）
+    const size_t targetTriangles = std::max<size_t>(params.targetVertices / 3, 1);
+    const int segments = std::clamp((int)std::lround(std::sqrt((double)targetTriangles / (2.0 * boneList.size()))), 6, 64);
+    const double rings = (double)targetTriangles / (2.0 * segments) - (double)limbs.size();
+    const int ringsPerBone = std::max(1, (int)std::lround(rings / boneList.size()));
+
+    // 按期望的外法线确定绕序
+    auto addTriangle = [this](unsigned int a, unsigned int b, unsigned int c, const glm::vec3 &outward)
+    {
+        glm::vec3 n = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+        if (glm::dot(n, outward) < 0.0f)
+            std::swap(b, c);
+        triangles.insert(triangles.end(), {a, b, c});
+    };
+
+    // 3. 每个肢体一根封口的圆管：环沿骨骼分布，环的坐标系平行移动避免扭转，半径沿肢体逐渐变细
+    for (const Limb &limb : limbs)
+    {
+        if (limb.boneCount == 0)
+            continue;
+
+        const GeneratedBone &first = boneList[limb.firstBone];
+        glm::vec3 u = perpendicular(glm::normalize(first.tail - first.head));
+        std::vector<unsigned int> ringStarts;
+        const int ringCount = (int)limb.boneCount * ringsPerBone + 1;
+        for (int r = 0; r < ringCount; r++)
+        {
+            size_t b = std::min((size_t)(r / ringsPerBone), limb.boneCount - 1);
+            float t = (float)(r - (int)b * ringsPerBone) / ringsPerBone;
+            const GeneratedBone &bone = boneList[limb.firstBone + b];
+            glm::vec3 axis = glm::normalize(bone.tail - bone.head);
+            glm::vec3 center = bone.head + (bone.tail - bone.head) * t;
+
+            u = glm::normalize(u - axis * glm::dot(u, axis));
+            glm::vec3 v = glm::cross(axis, u);
+            float s = (float)r / (ringCount - 1);
+            float radius = limb.radius * (1.0f - 0.35f * s);
+
+            ringStarts.push_back((unsigned int)positions.size());
+            for (int k = 0; k < segments; k++)
+            {
+                float a = 2.0f * PI * k / segments;
+                glm::vec3 n = u * std::cos(a) + v * std::sin(a);
+                positions.push_back(center + n * radius);
+                normals.push_back(n);
+            }
+        }
+
+        for (int r = 0; r + 1 < ringCount; r++)
+        {
+            for (int k = 0; k < segments; k++)
+            {
+                unsigned int a = ringStarts[r] + k, b = ringStarts[r] + (k + 1) % segments;
+                unsigned int c = ringStarts[r + 1] + (k + 1) % segments, d = ringStarts[r + 1] + k;
+                addTriangle(a, b, c, normals[a]);
+                addTriangle(a, c, d, normals[a]);
+            }
+        }
+
+        // 两端用扇形封口，顶点略微凸出成半球形的端帽
+        const GeneratedBone &last = boneList[limb.firstBone + limb.boneCount - 1];
+        glm::vec3 startAxis = glm::normalize(first.tail - first.head);
+        glm::vec3 endAxis = glm::normalize(last.tail - last.head);
+        float endRadius = limb.radius * 0.65f;
+        struct Cap
+        {
+            unsigned int ring;
+            glm::vec3 pole, normal;
+        } caps[2] = {{ringStarts.front(), first.head - startAxis * limb.radius * 0.6f, -startAxis},
+                     {ringStarts.back(), last.tail + endAxis * endRadius * 0.6f, endAxis}};
+        for (const Cap &cap : caps)
+        {
+            unsigned int pole = (unsigned int)positions.size();
+            positions.push_back(cap.pole);
+            normals.push_back(cap.normal);
+            for (int k = 0; k < segments; k++)
+                addTriangle(pole, cap.ring + k, cap.ring + (k + 1) % segments, cap.normal);
+        }
+    }
+    return true;
+}
+
+bool RigGenerator::writeOBJ(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+
+    // 每次攒一大块文本再写，百万顶点的文件也只需要零点几秒
+    std::string text;
+    char line[128];
+    auto flush = [&](bool force)
+    {
+        if (force || text.size() > (1 << 20))
+        {
+            file.write(text.data(), (std::streamsize)text.size());
+            text.clear();
+        }
+    };
+
+    text += "# generated rig: " + std::to_string(positions.size()) + " positions, " +
+            std::to_string(triangles.size() / 3) + " triangles, " + std::to_string(boneList.size()) + " bones\n";
+    for (const glm::vec3 &p : positions)
+    {
+        text.append(line, std::snprintf(line, sizeof(line), "v %.5f %.5f %.5f\n", p.x, p.y, p.z));
+        flush(false);
+    }
+    for (const glm::vec3 &n : normals)
+    {
+        text.append(line, std::snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", n.x, n.y, n.z));
+        flush(false);
+    }
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        unsigned int a = triangles[i] + 1, b = triangles[i + 1] + 1, c = triangles[i + 2] + 1;
+        text.append(line, std::snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c));
+        flush(false);
+    }
+    flush(true);
+    return (bool)file;
+}
+
+bool RigGenerator::writeSkeleton(const std::string &path) const
+{
+    // 字段顺序与现有的 skeleton.json 相同
+    nlohmann::ordered_json bones = nlohmann::ordered_json::array();
+    for (const GeneratedBone &b : boneList)
+    {
+        nlohmann::ordered_json bone;
+        bone["name"] = b.name;
+        bone["parent"] = b.parent < 0 ? nlohmann::ordered_json(nullptr) : nlohmann::ordered_json(boneList[b.parent].name);
+        bone["head"] = {b.head.x, b.head.y, b.head.z};
+        bone["tail"] = {b.tail.x, b.tail.y, b.tail.z};
+        bones.push_back(bone);
+    }
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    file << bones.dump(2) << std::endl;
+    return (bool)file;
+}
@@ -0,0 +1,403 @@
+#include "SelfCollision.h"
+#include "MemoryStats.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // 顶点上权重不小于它的骨骼会明显带动该顶点：三角形归属于在任一顶点上达到它的骨骼
+    const float OWNER_WEIGHT = 0.1f;
+    // 两个骨骼在同一个顶点上的权重都不小于它时，才认为它们共享影响区域
+    const float SHARED_WEIGHT = 0.2f;
+
+    float pointSegmentDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b)
+    {
+        glm::vec3 ab = b - a;
+        float len = glm::dot(ab, ab);
+        float t = len > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len, 0.0f, 1.0f) : 0.0f;
+        return glm::length(p - (a + ab * t));
+    }
+
+    // 两条线段之间的最短距离的平方（Ericson，Real-Time Collision Detection 5.1.9）
+    float segmentDistanceSquared(const glm::vec3 &p1, const glm::vec3 &q1, const glm::vec3 &p2, const glm::vec3 &q2)
+    {
+        const float eps = 1e-12f;
+        glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+        float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        float s, t;
+        if (a <= eps && e <= eps)
+            return glm::dot(r, r);
+        if (a <= eps)
+        {
+            s = 0.0f;
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        }
+        else
+        {
+            float c = glm::dot(d1, r);
+            if (e <= eps)
+            {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else
+            {
+                float b = glm::dot(d1, d2), denom = a * e - b * b;
+                s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if (t < 0.0f)
+                {
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                }
+                else if (t > 1.0f)
+                {
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        glm::vec3 d = (p1 + d1 * s) - (p2 + d2 * t);
+        return glm::dot(d, d);
+    }
+
+    // 线段 p-q 是否穿过三角形（Möller–Trumbore，双面）
+    bool segmentHitsTriangle(const glm::vec3 &p, const glm::vec3 &q, const glm::vec3 *tri)
+    {
+        glm::vec3 dir = q - p;
+        glm::vec3 e1 = tri[1] - tri[0], e2 = tri[2] - tri[0];
+        glm::vec3 pv = glm::cross(dir, e2);
+        float det = glm::dot(e1, pv);
+        if (std::abs(det) < 1e-12f)
+            return false;
+        float inv = 1.0f / det;
+        glm::vec3 tv = p - tri[0];
+        float u = glm::dot(tv, pv) * inv;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 qv = glm::cross(tv, e1);
+        float v = glm::dot(dir, qv) * inv;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float t = glm::dot(e2, qv) * inv;
+        return t >= 0.0f && t <= 1.0f;
+    }
+
+    // 三个顶点是否都严格在平面的同一侧
+    bool separatedByPlane(const glm::vec3 *plane, const glm::vec3 *tri)
+    {
+        glm::vec3 n = glm::cross(plane[1] - plane[0], plane[2] - plane[0]);
+        float d0 = glm::dot(n, tri[0] - plane[0]), d1 = glm::dot(n, tri[1] - plane[0]), d2 = glm::dot(n, tri[2] - plane[0]);
+        return (d0 > 0.0f && d1 > 0.0f && d2 > 0.0f) || (d0 < 0.0f && d1 < 0.0f && d2 < 0.0f);
+    }
+
+    // 两个不共面的三角形相交，当且仅当其中一个的某条边穿过另一个。共面的情况忽略
+    bool trianglesIntersect(const glm::vec3 *a, const glm::vec3 *b)
+    {
+        if (separatedByPlane(b, a) || separatedByPlane(a, b))
+            return false;
+        for (int i = 0; i < 3; i++)
+        {
+            if (segmentHitsTriangle(a[i], a[(i + 1) % 3], b) || segmentHitsTriangle(b[i], b[(i + 1) % 3], a))
+                return true;
+        }
+        return false;
+    }
+
+    // tri 的顶点沿 plane 的法线陷入其背面的最大距离
+    float depthBehind(const glm::vec3 *plane, const glm::vec3 *tri)
+    {
+        glm::vec3 n = glm::cross(plane[1] - plane[0], plane[2] - plane[0]);
+        float len = glm::length(n);
+        if (len <= 0.0f)
+            return 0.0f;
+        n /= len;
+        float depth = 0.0f;
+        for (int k = 0; k < 3; k++)
+            depth = std::max(depth, -glm::dot(n, tri[k] - plane[0]));
+        return depth;
+    }
+}
+
+void SelfCollision::prepare(const Mesh &mesh, const Skeleton &skeleton)
+{
+    const int boneCount = (int)skeleton.bones.size();
+    indices.assign(mesh.indices.begin(), mesh.indices.end() - mesh.indices.size() % 3);
+    const int triangles = (int)(indices.size() / 3);
+
+    // 按静止位置焊接顶点：网格按面角展开，相邻的面不共享顶点序号
+    const std::vector<unsigned int> welded = mesh.buildAdjacency().vertexToNode;
+    corners.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        corners[i] = (int)welded[indices[i]];
+
+    // 三角形归属于主导骨骼，以及在任一顶点上权重达到 OWNER_WEIGHT 的骨骼。
+    // 只取主导骨骼时，权重被相邻骨骼分走的骨骼（例如热扩散权重下的大腿）一个三角形也分不到
+    ownerStart.assign(triangles + 1, 0);
+    triangleOwners.clear();
+    boneTriangles.assign(boneCount, {});
+    for (int t = 0; t < triangles; t++)
+    {
+        const size_t first = triangleOwners.size();
+        auto addOwner = [&](int bone)
+        {
+            if (bone < 0 || bone >= boneCount ||
+                std::find(triangleOwners.begin() + first, triangleOwners.end(), bone) != triangleOwners.end())
+                return;
+            triangleOwners.push_back(bone);
+            boneTriangles[bone].push_back(t);
+        };
+        addOwner(mesh.dominantBone(t));
+        for (int k = 0; k < 3; k++)
+        {
+            const Vertex &v = mesh.vertices[indices[3 * t + k]];
+            for (int j = 0; j < 4; j++)
+                if (v.weights[j] >= OWNER_WEIGHT)
+                    addOwner(v.boneIDs[j]);
+        }
+        std::sort(triangleOwners.begin() + first, triangleOwners.end());
+        ownerStart[t + 1] = (int)triangleOwners.size();
+    }
+
+    // 不参与检测的骨骼对：父子骨骼，以及在同一个顶点上权重都达到 SHARED_WEIGHT 的骨骼。
+    // 权重很小的共享（例如骨盆上沾到一点小腿的权重）不算，否则两侧腿之间的接触全被排除
+    excluded.assign((size_t)boneCount * boneCount, 0);
+    auto exclude = [&](int a, int b)
+    {
+        excluded[(size_t)a * boneCount + b] = 1;
+        excluded[(size_t)b * boneCount + a] = 1;
+    };
+    for (int b = 0; b < boneCount; b++)
+    {
+        int p = skeleton.bones[b].parent;
+        if (p >= 0 && p < boneCount)
+            exclude(b, p);
+    }
+    for (const Vertex &v : mesh.vertices)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            if (v.boneIDs[j] < 0 || v.boneIDs[j] >= boneCount || v.weights[j] < SHARED_WEIGHT)
+                continue;
+            for (int k = j + 1; k < 4; k++)
+            {
+                if (v.boneIDs[k] >= 0 && v.boneIDs[k] < boneCount && v.weights[k] >= SHARED_WEIGHT)
+                    exclude(v.boneIDs[j], v.boneIDs[k]);
+            }
+        }
+    }
+
+    // 静止姿态的胶囊轴：骨骼所属三角形顶点的主成分方向（幂迭代），两端取顶点在轴上投影的范围
+    restCapsules.assign(boneCount, Capsule());
+    for (int b = 0; b < boneCount; b++)
+    {
+        if (boneTriangles[b].empty())
+            continue;
+        glm::vec3 mean(0.0f);
+        BoundingBox box;
+        for (int t : boneTriangles[b])
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec3 &p = mesh.vertices[indices[3 * t + k]].position;
+                mean += p;
+                box.expand(p);
+            }
+        }
+        mean /= (float)(boneTriangles[b].size() * 3);
+
+        glm::mat3 covariance(0.0f);
+        for (int t : boneTriangles[b])
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                glm::vec3 d = mesh.vertices[indices[3 * t + k]].position - mean;
+                covariance += glm::outerProduct(d, d);
+            }
+        }
+        glm::vec3 extent = box.max - box.min;
+        glm::vec3 axis = extent.x > extent.y ? (extent.x > extent.z ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1))
+                                             : (extent.y > extent.z ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, 1));
+        for (int it = 0; it < 32; it++)
+        {
+            glm::vec3 next = covariance * axis;
+            float len = glm::length(next);
+            if (len <= 1e-20f)
+                break;
+            axis = next / len;
+        }
+
+        float lo = 0.0f, hi = 0.0f;
+        for (int t : boneTriangles[b])
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                float s = glm::dot(mesh.vertices[indices[3 * t + k]].position - mean, axis);
+                lo = std::min(lo, s);
+                hi = std::max(hi, s);
+            }
+        }
+        restCapsules[b] = {mean + axis * lo, mean + axis * hi, 0.0f};
+    }
+
+    candidatePairs.clear();
+    for (int a = 0; a < boneCount; a++)
+    {
+        if (boneTriangles[a].empty())
+            continue;
+        for (int b = a + 1; b < boneCount; b++)
+        {
+            if (!boneTriangles[b].empty() && !excluded[(size_t)a * boneCount + b])
+                candidatePairs.push_back({a, b});
+        }
+    }
+    capsules = restCapsules;
+    capsuleBoxes.assign(boneCount, BoundingBox());
+
+    MemoryStats::set(MemoryCategory::Caches, "Self collision",
+                     MemoryStats::bytes(indices) + MemoryStats::bytes(corners) + MemoryStats::bytes(ownerStart) +
+                         MemoryStats::bytes(triangleOwners) + triangleOwners.size() * sizeof(int) +
+                         MemoryStats::bytes(excluded) + MemoryStats::bytes(candidatePairs));
+}
+
+bool SelfCollision::ownedBy(int t, int bone) const
+{
+    for (int i = ownerStart[t]; i < ownerStart[t + 1]; i++)
+        if (triangleOwners[i] == bone)
+            return true;
+    return false;
+}
+
+bool SelfCollision::reportedUnder(int t, int u, int boneA, int boneB) const
+{
+    // 三角形可能属于多个骨骼，同一对三角形会在多个骨骼对下被找到：只在编号最小的那个候选骨骼对下报告。
+    // 骨骼的胶囊包住它的全部三角形，所以这个骨骼对一定通过了宽相位
+    const size_t boneCount = boneTriangles.size();
+    for (int i = ownerStart[t]; i < ownerStart[t + 1]; i++)
+    {
+        for (int j = ownerStart[u]; j < ownerStart[u + 1]; j++)
+        {
+            int a = std::min(triangleOwners[i], triangleOwners[j]), b = std::max(triangleOwners[i], triangleOwners[j]);
+            if (a != b && !excluded[(size_t)a * boneCount + b] && std::make_pair(a, b) < std::make_pair(boneA, boneB))
+                return false;
+        }
+    }
+    return true;
+}
+
+void SelfCollision::detect(const TriangleBVH &bvh, const SkinnedVertices &vertices, const glm::mat4 *palette,
+                           SelfCollisionReport &report)
+{
+    PROFILE_SCOPE("Self collision");
+    report.pairs.clear();
+    report.maxDepth = 0.0f;
+    report.triangleTests = 0;
+
+    // 胶囊跟随骨骼变换，半径按蒙皮后的顶点重新计算，保证包住骨骼的所有三角形
+    parallelFor(0, capsules.size(), 4, [&](size_t begin, size_t end)
+                {
+                    for (size_t b = begin; b < end; b++)
+                    {
+                        if (restCapsules[b].radius < 0.0f)
+                            continue;
+                        Capsule &c = capsules[b];
+                        c.a = glm::vec3(palette[b] * glm::vec4(restCapsules[b].a, 1.0f));
+                        c.b = glm::vec3(palette[b] * glm::vec4(restCapsules[b].b, 1.0f));
+                        c.radius = 0.0f;
+                        for (int t : boneTriangles[b])
+                            for (int k = 0; k < 3; k++)
+                                c.radius = std::max(c.radius, pointSegmentDistance(vertices.position(indices[3 * t + k]), c.a, c.b));
+
+                        BoundingBox box;
+                        box.expand(glm::min(c.a, c.b) - glm::vec3(c.radius));
+                        box.expand(glm::max(c.a, c.b) + glm::vec3(c.radius));
+                        capsuleBoxes[b] = box;
+                    }
+                });
+
+    // 宽相位
+    overlapping.clear();
+    for (const auto &pair : candidatePairs)
+    {
+        const Capsule &a = capsules[pair.first], &b = capsules[pair.second];
+        float reach = a.radius + b.radius;
+        if (capsuleBoxes[pair.first].overlaps(capsuleBoxes[pair.second]) &&
+            segmentDistanceSquared(a.a, a.b, b.a, b.b) <= reach * reach)
+            overlapping.push_back(pair);
+    }
+    report.bonePairs = overlapping.size();
+
+    // 窄相位：骨骼对之间互不依赖，并行测试后按骨骼对的顺序合并，结果与线程数无关
+    pairResults.resize(overlapping.size());
+    pairTests.assign(overlapping.size(), 0);
+    parallelFor(0, overlapping.size(), 1, [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        pairResults[i].clear();
+                        testBonePair(bvh, overlapping[i].first, overlapping[i].second, pairResults[i], pairTests[i]);
+                    }
+                });
+    for (size_t i = 0; i < overlapping.size(); i++)
+    {
+        report.triangleTests += pairTests[i];
+        for (const TrianglePair &pair : pairResults[i])
+        {
+            report.pairs.push_back(pair);
+            report.maxDepth = std::max(report.maxDepth, pair.depth);
+        }
+    }
+}
+
+void SelfCollision::testBonePair(const TriangleBVH &bvh, int boneA, int boneB, std::vector<TrianglePair> &pairs,
+                                 size_t &tests) const
+{
+    // 遍历三角形较少的一侧，只取落在另一侧胶囊包围盒内的三角形，再用 BVH 找另一侧与它重叠的三角形
+    const bool swapSides = boneTriangles[boneA].size() > boneTriangles[boneB].size();
+    const int outer = swapSides ? boneB : boneA, inner = swapSides ? boneA : boneB;
+    const BoundingBox &region = capsuleBoxes[inner];
+
+    std::vector<int> found;
+    for (int t : boneTriangles[outer])
+    {
+        const BoundingBox &box = bvh.triangleBounds(t);
+        if (!box.overlaps(region))
+            continue;
+        found.clear();
+        bvh.query(box, found);
+
+        glm::vec3 triT[3];
+        bool loaded = false;
+        for (int u : found)
+        {
+            // 两个三角形同时属于这两个骨骼时，两个方向都会找到这一对，只测试一次
+            if (!ownedBy(u, inner) || (u < t && ownedBy(u, outer) && ownedBy(t, inner)))
+                continue;
+            bool adjacent = false;
+            for (int i = 0; i < 3 && !adjacent; i++)
+                for (int j = 0; j < 3 && !adjacent; j++)
+                    adjacent = corners[3 * t + i] == corners[3 * u + j];
+            if (adjacent)
+                continue;
+
+            if (!loaded)
+            {
+                bvh.triangle(t, triT[0], triT[1], triT[2]);
+                loaded = true;
+            }
+            glm::vec3 triU[3];
+            bvh.triangle(u, triU[0], triU[1], triU[2]);
+            tests++;
+            if (!trianglesIntersect(triT, triU) || !reportedUnder(t, u, boneA, boneB))
+                continue;
+
+            float depth = std::min(depthBehind(triU, triT), depthBehind(triT, triU));
+            if (swapSides)
+                pairs.push_back({u, t, boneA, boneB, depth});
+            else
+                pairs.push_back({t, u, boneA, boneB, depth});
+        }
+    }
+}
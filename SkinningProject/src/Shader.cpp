@@ -2,9 +2,10 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include <glad/glad.h>
 
-Shader::Shader() : programID(0) {}
+Shader::Shader() : programID(0), savedCalls(0) {}
 
 Shader::~Shader()
 {
@@ -12,7 +13,22 @@ Shader::~Shader()
         glDeleteProgram(programID);
 }
 
-bool Shader::loadFromFiles(const std::string &vertexPath, const std::string &fragmentPath)
+// 把宏定义插入到 #version 行之后（GLSL 要求 #version 是第一条语句）
+static std::string injectDefines(const std::string &code, const std::string &defines)
+{
+    if (defines.empty())
+        return code;
+    size_t pos = 0;
+    if (code.compare(0, 8, "#version") == 0)
+    {
+        pos = code.find('\n');
+        pos = (pos == std::string::npos) ? code.size() : pos + 1;
+    }
+    return code.substr(0, pos) + defines + code.substr(pos);
+}
+
+bool Shader::loadFromFiles(const std::string &vertexPath, const std::string &fragmentPath,
+                           const std::string &defines)
 {
     std::string vertexCode, fragmentCode;
     std::ifstream vShaderFile, fShaderFile;
@@ -41,13 +57,16 @@ bool Shader::loadFromFiles(const std::string &vertexPath, const std::string &fra
         return false;
     }
 
-    return compile(vertexCode, fragmentCode);
+    return compile(vertexCode, fragmentCode, defines);
 }
 
-bool Shader::compile(const std::string &vertexCode, const std::string &fragmentCode)
+bool Shader::compile(const std::string &vertexCode, const std::string &fragmentCode,
+                     const std::string &defines)
 {
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
+    const std::string vertexSource = injectDefines(vertexCode, defines);
+    const std::string fragmentSource = injectDefines(fragmentCode, defines);
+    const char *vShaderCode = vertexSource.c_str();
+    const char *fShaderCode = fragmentSource.c_str();
 
     unsigned int vertex, fragment;
     int success;
@@ -97,26 +116,137 @@ bool Shader::compile(const std::string &vertexCode, const std::string &fragmentC
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 
+    reflect();
+
     return true;
 }
 
+void Shader::reflect()
+{
+    uniformTable.clear();
+    blockTable.clear();
+
+    int count = 0;
+    char name[256];
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+
+        Uniform u;
+        u.name.assign(name, length);
+        u.location = glGetUniformLocation(programID, name);
+        u.type = type;
+        u.size = size;
+
+        // 位于 uniform block 中的成员没有 location，不放进表里
+        if (u.location < 0)
+            continue;
+        if (u.name.size() > 3 && u.name.compare(u.name.size() - 3, 3, "[0]") == 0)
+            u.name.resize(u.name.size() - 3);
+        uniformTable.push_back(u);
+    }
+
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(programID, (GLuint)i, sizeof(name), &length, name);
+
+        UniformBlock b;
+        b.name.assign(name, length);
+        b.index = (unsigned int)i;
+        glGetActiveUniformBlockiv(programID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &b.dataSize);
+        blockTable.push_back(b);
+    }
+}
+
 void Shader::use()
 {
     glUseProgram(programID);
 }
 
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+int Shader::uniform(const std::string &name) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    for (size_t i = 0; i < uniformTable.size(); i++)
+    {
+        if (uniformTable[i].name == name)
+            return (int)i;
+    }
+    return -1;
 }
 
-void Shader::setMat4Array(const std::string &name, const std::vector<glm::mat4> &mats) const
+// 值与上一次上传相同则跳过，并计入省掉的调用
+bool Shader::changed(Uniform &u, const void *data, size_t bytes)
 {
-    glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), mats.size(), GL_FALSE, &mats[0][0][0]);
+    if (u.value.size() == bytes && std::memcmp(u.value.data(), data, bytes) == 0)
+    {
+        savedCalls++;
+        return false;
+    }
+    u.value.assign((const unsigned char *)data, (const unsigned char *)data + bytes);
+    return true;
 }
 
-void Shader::setVec3(const std::string &name, const glm::vec3 &vec) const
+void Shader::setMat4(int handle, const glm::mat4 &mat)
 {
-    glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, &vec[0]);
+    if (handle < 0)
+        return;
+    Uniform &u = uniformTable[handle];
+    if (changed(u, &mat[0][0], sizeof(glm::mat4)))
+        glUniformMatrix4fv(u.location, 1, GL_FALSE, &mat[0][0]);
 }
 
+void Shader::setMat4Array(int handle, const glm::mat4 *mats, int count)
+{
+    if (handle < 0 || count <= 0)
+        return;
+    Uniform &u = uniformTable[handle];
+    if (changed(u, &mats[0][0][0], count * sizeof(glm::mat4)))
+        glUniformMatrix4fv(u.location, count, GL_FALSE, &mats[0][0][0]);
+}
+
+void Shader::setVec3(int handle, const glm::vec3 &vec)
+{
+    if (handle < 0)
+        return;
+    Uniform &u = uniformTable[handle];
+    if (changed(u, &vec[0], sizeof(glm::vec3)))
+        glUniform3fv(u.location, 1, &vec[0]);
+}
+
+void Shader::setInt(int handle, int value)
+{
+    if (handle < 0)
+        return;
+    Uniform &u = uniformTable[handle];
+    if (changed(u, &value, sizeof(int)))
+        glUniform1i(u.location, value);
+}
+
+void Shader::setMat4(const std::string &name, const glm::mat4 &mat)
+{
+    savedCalls++;
+    setMat4(uniform(name), mat);
+}
+
+void Shader::setMat4Array(const std::string &name, const std::vector<glm::mat4> &mats)
+{
+    savedCalls++;
+    setMat4Array(uniform(name), mats.data(), (int)mats.size());
+}
+
+void Shader::setVec3(const std::string &name, const glm::vec3 &vec)
+{
+    savedCalls++;
+    setVec3(uniform(name), vec);
+}
+
+void Shader::setInt(const std::string &name, int value)
+{
+    savedCalls++;
+    setInt(uniform(name), value);
+}
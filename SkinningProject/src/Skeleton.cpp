@@ -1,32 +1,186 @@
 #include "Skeleton.h"
+#include "Arena.h"
+#include "Profiler.h"
 #include "json.hpp"
 #include <fstream>
+#include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <map>
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 using json = nlohmann::json;
 
+namespace
+{
+    // 从 JSON 中读到的一根骨骼，字符串指向内存池
+    struct BoneRecord
+    {
+        std::string_view name;
+        std::string_view parent;
+        bool hasParent = false;
+        glm::vec3 head = glm::vec3(0.0f);
+        glm::vec3 tail = glm::vec3(0.0f);
+    };
+
+    // SAX 解析：边解析边填 BoneRecord，不构建 JSON DOM。
+    // 结构为 [{"name": .., "parent": .. | null, "head": [x, y, z], "tail": [x, y, z]}, ...]，其他字段忽略
+    class SkeletonReader
+    {
+    public:
+        SkeletonReader(Arena &arena, std::vector<BoneRecord, ArenaAllocator<BoneRecord>> &records)
+            : arena(arena), records(records) {}
+
+        bool null()
+        {
+            if (depth == 2 && field == Field::Parent)
+                records.back().hasParent = false;
+            return true;
+        }
+        bool boolean(bool) { return true; }
+        bool number_integer(json::number_integer_t value) { return number((float)value); }
+        bool number_unsigned(json::number_unsigned_t value) { return number((float)value); }
+        bool number_float(json::number_float_t value, const json::string_t &) { return number((float)value); }
+        bool string(json::string_t &value)
+        {
+            if (depth != 2)
+                return true;
+            if (field == Field::Name)
+                records.back().name = arena.copyString(value);
+            else if (field == Field::Parent)
+            {
+                records.back().parent = arena.copyString(value);
+                records.back().hasParent = true;
+            }
+            return true;
+        }
+        bool binary(json::binary_t &) { return true; }
+
+        bool start_object(std::size_t)
+        {
+            if (++depth == 2)
+                records.emplace_back();
+            return true;
+        }
+        bool key(json::string_t &value)
+        {
+            if (depth == 2)
+            {
+                field = value == "name"     ? Field::Name
+                        : value == "parent" ? Field::Parent
+                        : value == "head"   ? Field::Head
+                        : value == "tail"   ? Field::Tail
+                                            : Field::Other;
+                component = 0;
+            }
+            return true;
+        }
+        bool end_object()
+        {
+            depth--;
+            return true;
+        }
+        bool start_array(std::size_t)
+        {
+            depth++;
+            return true;
+        }
+        bool end_array()
+        {
+            depth--;
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string &, const json::exception &e)
+        {
+            error = e.what();
+            return false;
+        }
+
+        std::string error;
+
+    private:
+        bool number(float value)
+        {
+            // head / tail 数组里的分量
+            if (depth == 3 && component < 3)
+            {
+                if (field == Field::Head)
+                    records.back().head[component++] = value;
+                else if (field == Field::Tail)
+                    records.back().tail[component++] = value;
+            }
+            return true;
+        }
+
+        Arena &arena;
+        std::vector<BoneRecord, ArenaAllocator<BoneRecord>> &records;
+        enum class Field
+        {
+            Other,
+            Name,
+            Parent,
+            Head,
+            Tail
+        };
+
+        int depth = 0; // 1: 骨骼数组，2: 骨骼对象，3: head / tail
+        Field field = Field::Other; // 骨骼对象中当前的字段
+        int component = 0;
+    };
+}
+
 bool Skeleton::loadFromJSON(const std::string &path)
 {
-    std::ifstream f(path);
-    json j;
-    f >> j;
+    PROFILE_SCOPE("Skeleton::loadFromJSON");
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f)
+    {
+        std::cerr << "Failed to open skeleton: " << path << std::endl;
+        return false;
+    }
+
+    // 文件内容、骨骼记录和名称表都是临时数据，放在内存池里，函数返回时一次释放
+    Arena arena;
+    const size_t size = (size_t)f.tellg();
+    char *text = arena.allocateArray<char>(size);
+    f.seekg(0);
+    if (!f.read(text, (std::streamsize)size))
+    {
+        std::cerr << "Failed to read skeleton: " << path << std::endl;
+        return false;
+    }
 
-    std::map<std::string, int> nameToIndex;
+    std::vector<BoneRecord, ArenaAllocator<BoneRecord>> records{ArenaAllocator<BoneRecord>(arena)};
+    records.reserve(size / 128 + 1); // 每根骨骼至少一百多字节，多数情况下不会再扩容
+    SkeletonReader reader(arena, records);
+    if (!json::sax_parse(text, text + size, &reader))
+    {
+        std::cerr << "Failed to parse skeleton " << path << ": " << reader.error << std::endl;
+        return false;
+    }
+
+    using NameMap = std::unordered_map<std::string_view, int, std::hash<std::string_view>, std::equal_to<std::string_view>,
+                                       ArenaAllocator<std::pair<const std::string_view, int>>>;
+    NameMap nameToIndex(records.size() * 2, std::hash<std::string_view>(), std::equal_to<std::string_view>(),
+                        ArenaAllocator<std::pair<const std::string_view, int>>(arena));
 
     // 第一遍：创建所有骨骼并建立名称映射
-    for (size_t i = 0; i < j.size(); i++)
+    bones.reserve(bones.size() + records.size());
+    for (size_t i = 0; i < records.size(); i++)
     {
-        auto &b = j[i];
+        const BoneRecord &b = records[i];
         Bone bone;
         bone.id = i;
-        bone.name = b["name"];
-        nameToIndex[bone.name] = i;
+        bone.name = std::string(b.name);
+        nameToIndex[b.name] = i;
 
         // 从head/tail构建矩阵
-        glm::vec3 head(b["head"][0], b["head"][1], b["head"][2]);
-        glm::vec3 tail(b["tail"][0], b["tail"][1], b["tail"][2]);
+        glm::vec3 head = b.head;
+        glm::vec3 tail = b.tail;
         glm::vec3 dir = glm::normalize(tail - head);
 
         // 构建局部坐标系矩阵
@@ -43,22 +197,23 @@ bool Skeleton::loadFromJSON(const std::string &path)
             glm::vec4(dir, 0),
             glm::vec4(head, 1));
         bone.invRestMatrix = glm::inverse(bone.restMatrix);
+        bone.tail = tail;
 
         bones.push_back(bone);
     }
 
-    // 第二遍：设置parent索引
-    for (size_t i = 0; i < j.size(); i++)
+    // 第二遍：设置parent索引（找不到的父骨骼名与之前一样映射到 0）
+    for (size_t i = 0; i < records.size(); i++)
     {
-        auto &b = j[i];
-        if (b["parent"].is_null())
+        const BoneRecord &b = records[i];
+        if (!b.hasParent)
         {
             bones[i].parent = -1;
         }
         else
         {
-            std::string parentName = b["parent"];
-            bones[i].parent = nameToIndex[parentName];
+            auto it = nameToIndex.find(b.parent);
+            bones[i].parent = it != nameToIndex.end() ? it->second : 0;
         }
     }
 
@@ -83,3 +238,54 @@ void Skeleton::computePoseMatrices()
         }
     }
 }
+
+int Skeleton::findBone(const std::string &name) const
+{
+    for (size_t i = 0; i < bones.size(); i++)
+    {
+        if (bones[i].name == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+const std::vector<glm::mat4> &Skeleton::computeBoneMatrices(glm::mat4 *out) const
+{
+    PROFILE_SCOPE("Bone palette");
+    // 映射的 GPU 内存只写不读，父骨骼的累积结果放在线程局部的复用缓冲里
+    static thread_local std::vector<glm::mat4> global;
+    global.resize(bones.size());
+
+    for (size_t i = 0; i < bones.size(); ++i)
+    {
+        int p = bones[i].parent;
+        glm::mat4 local = bones[i].poseMatrix * bones[i].invRestMatrix;
+
+        // 所有骨骼都累乘父骨骼
+        global[i] = (p == -1) ? local : global[p] * local;
+        out[i] = global[i];
+    }
+    return global;
+}
+
+bool Skeleton::isUniformScale(const glm::mat4 &m)
+{
+    // M^T M = s^2 I：三个轴两两正交且长度相同
+    glm::vec3 x(m[0]), y(m[1]), z(m[2]);
+    float xx = glm::dot(x, x), yy = glm::dot(y, y), zz = glm::dot(z, z);
+    float tolerance = 1e-3f * std::max(xx, std::max(yy, zz));
+    return std::abs(xx - yy) <= tolerance && std::abs(xx - zz) <= tolerance &&
+           std::abs(glm::dot(x, y)) <= tolerance && std::abs(glm::dot(x, z)) <= tolerance &&
+           std::abs(glm::dot(y, z)) <= tolerance;
+}
+
+bool Skeleton::hasNonUniformScale() const
+{
+    // 每根骨骼的局部变换都是均匀缩放时，沿父链累乘的结果也是
+    for (const auto &b : bones)
+    {
+        if (!isUniformScale(b.poseMatrix * b.invRestMatrix))
+            return true;
+    }
+    return false;
+}
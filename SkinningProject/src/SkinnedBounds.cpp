@@ -0,0 +1,233 @@
+#include "SkinnedBounds.h"
+#include "MemoryStats.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+BoundingBox::BoundingBox()
+    : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max())
+{
+}
+
+void BoundingBox::expand(const glm::vec3 &p)
+{
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+}
+
+void BoundingBox::expand(const BoundingBox &box)
+{
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4 &m) const
+{
+    if (empty())
+        return *this;
+
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+
+    glm::vec3 c = glm::vec3(m * glm::vec4(center, 1.0f));
+    glm::vec3 e(0.0f);
+    for (int col = 0; col < 3; col++)
+    {
+        e.x += std::abs(m[col][0]) * extent[col];
+        e.y += std::abs(m[col][1]) * extent[col];
+        e.z += std::abs(m[col][2]) * extent[col];
+    }
+
+    BoundingBox result;
+    result.min = c - e;
+    result.max = c + e;
+    return result;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4 &m)
+{
+    // glm 按列存放，row(i) 取矩阵的第 i 行；裁剪空间 -w <= x, y, z <= w
+    auto row = [&m](int i)
+    { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+    Frustum f;
+    f.planes[0] = row(3) + row(0); // 左
+    f.planes[1] = row(3) - row(0); // 右
+    f.planes[2] = row(3) + row(1); // 下
+    f.planes[3] = row(3) - row(1); // 上
+    f.planes[4] = row(3) + row(2); // 近
+    f.planes[5] = row(3) - row(2); // 远
+    return f;
+}
+
+bool Frustum::intersects(const BoundingBox &box) const
+{
+    if (box.empty())
+        return false;
+
+    for (const glm::vec4 &p : planes)
+    {
+        // 取包围盒在平面法线方向上最远的角点，它都在外侧则整个盒子在外侧
+        glm::vec3 corner(p.x >= 0.0f ? box.max.x : box.min.x,
+                         p.y >= 0.0f ? box.max.y : box.min.y,
+                         p.z >= 0.0f ? box.max.z : box.min.z);
+        if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// 顶点权重最大的骨骼，没有权重时返回 -1
+static int dominantBone(const Vertex &v)
+{
+    int bone = -1;
+    float best = 0.0f;
+    for (int k = 0; k < 4; k++)
+    {
+        if (v.boneIDs[k] >= 0 && v.weights[k] > best)
+        {
+            best = v.weights[k];
+            bone = v.boneIDs[k];
+        }
+    }
+    return bone;
+}
+
+std::vector<int> SkinnedBounds::partitionBones(const Skeleton &skeleton, const Mesh &mesh, int partitions)
+{
+    const size_t boneCount = skeleton.bones.size();
+    std::vector<int> partition(boneCount, 0);
+    if (partitions <= 1 || boneCount == 0)
+        return partition;
+
+    // 每个骨骼主导的顶点数
+    std::vector<size_t> load(boneCount, 0);
+    size_t total = 0;
+    for (const Vertex &v : mesh.vertices)
+    {
+        int bone = dominantBone(v);
+        if (bone >= 0 && bone < (int)boneCount)
+        {
+            load[bone]++;
+            total++;
+        }
+    }
+
+    // 深度优先序：同一条肢体上的骨骼相邻，切成连续的段后每组在空间上也比较集中
+    std::vector<std::vector<int>> children(boneCount);
+    std::vector<int> stack;
+    for (size_t i = 0; i < boneCount; i++)
+    {
+        int p = skeleton.bones[i].parent;
+        if (p >= 0 && p < (int)boneCount)
+            children[p].push_back((int)i);
+        else
+            stack.push_back((int)i);
+    }
+    std::reverse(stack.begin(), stack.end());
+
+    std::vector<int> order;
+    order.reserve(boneCount);
+    while (!stack.empty())
+    {
+        int bone = stack.back();
+        stack.pop_back();
+        order.push_back(bone);
+        for (auto it = children[bone].rbegin(); it != children[bone].rend(); ++it)
+            stack.push_back(*it);
+    }
+
+    // 按累计顶点数均分
+    size_t accumulated = 0;
+    int current = 0;
+    for (int bone : order)
+    {
+        partition[bone] = current;
+        accumulated += load[bone];
+        if (current + 1 < partitions && accumulated * partitions >= total * (size_t)(current + 1))
+            current++;
+    }
+    return partition;
+}
+
+void SkinnedBounds::build(const Mesh &mesh, size_t boneCount, const std::vector<DrawRange> &ranges)
+{
+    boneBoxes.assign(boneCount, BoundingBox());
+    restBox = BoundingBox();
+    for (const Vertex &v : mesh.vertices)
+    {
+        bool weighted = false;
+        for (int k = 0; k < 4; k++)
+        {
+            if (v.boneIDs[k] >= 0 && v.boneIDs[k] < (int)boneCount && v.weights[k] > 0.0f)
+            {
+                boneBoxes[v.boneIDs[k]].expand(v.position);
+                weighted = true;
+            }
+        }
+        if (!weighted)
+            restBox.expand(v.position);
+    }
+
+    // 每个区间用到的骨骼：按骨骼做标记，避免重复
+    rangeBones.assign(ranges.size(), std::vector<int>());
+    std::vector<size_t> mark(boneCount + 1, (size_t)-1);
+    for (size_t r = 0; r < ranges.size(); r++)
+    {
+        const DrawRange &range = ranges[r];
+        for (unsigned int i = range.first; i < range.first + range.count; i++)
+        {
+            const Vertex &v = mesh.vertices[mesh.indices[i]];
+            bool weighted = false;
+            for (int k = 0; k < 4; k++)
+            {
+                int bone = v.boneIDs[k];
+                if (bone < 0 || bone >= (int)boneCount || v.weights[k] <= 0.0f)
+                    continue;
+                weighted = true;
+                if (mark[bone] != r)
+                {
+                    mark[bone] = r;
+                    rangeBones[r].push_back(bone);
+                }
+            }
+            if (!weighted && mark[boneCount] != r)
+            {
+                mark[boneCount] = r;
+                rangeBones[r].push_back(-1);
+            }
+        }
+    }
+
+    size_t bytes = MemoryStats::bytes(boneBoxes) + MemoryStats::bytes(rangeBones);
+    for (const auto &bones : rangeBones)
+        bytes += MemoryStats::bytes(bones);
+    MemoryStats::set(MemoryCategory::Caches, "Skinned bounds", bytes);
+}
+
+void SkinnedBounds::compute(const glm::mat4 *palette, const glm::mat4 &model,
+                            BoundingBox &character, BoundingBox *rangeBounds) const
+{
+    static thread_local std::vector<BoundingBox> world;
+    world.resize(boneBoxes.size());
+
+    character = restBox.transformed(model);
+    BoundingBox restWorld = character;
+    for (size_t b = 0; b < boneBoxes.size(); b++)
+    {
+        if (boneBoxes[b].empty())
+            continue;
+        world[b] = boneBoxes[b].transformed(model * palette[b]);
+        character.expand(world[b]);
+    }
+
+    if (!rangeBounds)
+        return;
+    for (size_t r = 0; r < rangeBones.size(); r++)
+    {
+        BoundingBox box;
+        for (int bone : rangeBones[r])
+            box.expand(bone < 0 ? restWorld : world[bone]);
+        rangeBounds[r] = box;
+    }
+}
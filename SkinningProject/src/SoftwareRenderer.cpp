@@ -0,0 +1,404 @@
+#include "SoftwareRenderer.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const unsigned int NO_TRIANGLE = 0xffffffffu;
+    const int BLOCKS_PER_TILE = SoftwareRenderer::TILE_SIZE / SoftwareRenderer::BLOCK_SIZE;
+    const float NEAR_W = 1e-5f; // w 不大于它的顶点视为在相机后面
+
+    // 与 GPU 的 unorm8 转换一致：就近取整（偶数优先）
+    inline unsigned char toByte(float x)
+    {
+        x = std::min(1.0f, std::max(0.0f, x));
+        return (unsigned char)std::lrint(x * 255.0f);
+    }
+}
+
+SoftwareRenderer::SoftwareRenderer()
+    : width(0), height(0), channels(3), tilesX(0), tilesY(0), viewProjection(1.0f),
+      viewPos(0.0f), lightDir(0.0f, -1.0f, 0.0f), lightColor(1.0f), clearColor(0.0f),
+      vertexCount(0), indexCount(0), triangleTotalLastFrame(0)
+{
+}
+
+bool SoftwareRenderer::create(int w, int h, int c)
+{
+    width = w;
+    height = h;
+    channels = c == 4 ? 4 : 3;
+    clearRow.clear();
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    color.assign((size_t)width * height * channels, 255);
+    MemoryStats::set(MemoryCategory::FrameBuffers, "Software framebuffer", MemoryStats::bytes(color));
+    return width > 0 && height > 0;
+}
+
+void SoftwareRenderer::beginFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &eye,
+                                  const glm::vec3 &light, const glm::vec3 &lightRgb, const glm::vec3 &clear)
+{
+    viewProjection = projection * view;
+    viewPos = eye;
+    lightDir = light;
+    lightColor = lightRgb;
+    if (clear != clearColor || clearRow.empty())
+    {
+        clearColor = clear;
+        // 一行 tile 宽度的背景色，填充时按行拷贝
+        clearRow.resize((size_t)TILE_SIZE * channels);
+        for (int x = 0; x < TILE_SIZE; x++)
+        {
+            clearRow[x * channels] = toByte(clear.r);
+            clearRow[x * channels + 1] = toByte(clear.g);
+            clearRow[x * channels + 2] = toByte(clear.b);
+            if (channels == 4)
+                clearRow[x * channels + 3] = 255;
+        }
+    }
+    vertexCount = 0;
+    indexCount = 0;
+}
+
+void SoftwareRenderer::drawMesh(const SkinnedVertices &skinned, const std::vector<unsigned int> &meshIndices,
+                                const glm::mat4 &model)
+{
+    // 缓冲只增不减，之后的帧不再重新分配或初始化
+    const size_t base = vertexCount;
+    vertexCount += skinned.count;
+    if (vertices.size() < vertexCount)
+        vertices.resize(vertexCount);
+
+    const glm::mat4 mvp = viewProjection * model;
+    const glm::mat3 normalMatrix(model);
+    const float halfW = width * 0.5f, halfH = height * 0.5f;
+    const float *px = skinned.px.data(), *py = skinned.py.data(), *pz = skinned.pz.data();
+    const float *nx = skinned.nx.data(), *ny = skinned.ny.data(), *nz = skinned.nz.data();
+    ScreenVertex *out = vertices.data() + base;
+    parallelFor(0, skinned.count, 4096, [&](size_t b, size_t e)
+                {
+                    for (size_t i = b; i < e; i++)
+                    {
+                        const float x = px[i], y = py[i], z = pz[i];
+                        const float cx = mvp[0][0] * x + mvp[1][0] * y + mvp[2][0] * z + mvp[3][0];
+                        const float cy = mvp[0][1] * x + mvp[1][1] * y + mvp[2][1] * z + mvp[3][1];
+                        const float cz = mvp[0][2] * x + mvp[1][2] * y + mvp[2][2] * z + mvp[3][2];
+                        const float cw = mvp[0][3] * x + mvp[1][3] * y + mvp[2][3] * z + mvp[3][3];
+                        ScreenVertex &v = out[i];
+                        v.invW = cw > NEAR_W ? 1.0f / cw : 0.0f;
+                        // 视口变换，y 向下：第 0 行是画面顶部
+                        v.x = (cx * v.invW + 1.0f) * halfW;
+                        v.y = (1.0f - cy * v.invW) * halfH;
+                        v.z = cz * v.invW * 0.5f + 0.5f;
+                        v.world = glm::vec3(model[0][0] * x + model[1][0] * y + model[2][0] * z + model[3][0],
+                                            model[0][1] * x + model[1][1] * y + model[2][1] * z + model[3][1],
+                                            model[0][2] * x + model[1][2] * y + model[2][2] * z + model[3][2]);
+                        v.normal = normalMatrix * glm::vec3(nx[i], ny[i], nz[i]);
+                    }
+                });
+
+    const size_t first = indexCount;
+    indexCount += meshIndices.size();
+    if (indices.size() < indexCount)
+        indices.resize(indexCount);
+    for (size_t i = 0; i < meshIndices.size(); i++)
+        indices[first + i] = meshIndices[i] + (unsigned int)base;
+}
+
+void SoftwareRenderer::setupTriangles(size_t begin, size_t end, std::vector<std::vector<unsigned int>> &bins)
+{
+    for (auto &bin : bins)
+        bin.clear();
+
+    for (size_t t = begin; t < end; t++)
+    {
+        Triangle &tri = triangles[t];
+        unsigned int a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+        const ScreenVertex *v[3] = {&vertices[a], &vertices[b], &vertices[c]};
+        tri.v[0] = a;
+        tri.v[1] = b;
+        tri.v[2] = c;
+        tri.x0 = 1;
+        tri.x1 = 0; // 空包围盒表示被剔除
+
+        // 场景固定、相机离角色较远，不做近平面裁剪：跨过相机平面的三角形直接丢弃
+        if (v[0]->invW <= 0.0f || v[1]->invW <= 0.0f || v[2]->invW <= 0.0f)
+            continue;
+        if (v[0]->z < 0.0f && v[1]->z < 0.0f && v[2]->z < 0.0f)
+            continue;
+        if (v[0]->z > 1.0f && v[1]->z > 1.0f && v[2]->z > 1.0f)
+            continue;
+
+        float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+        if (std::fabs(area) < 1e-12f)
+            continue;
+
+        float minX = std::min(v[0]->x, std::min(v[1]->x, v[2]->x));
+        float maxX = std::max(v[0]->x, std::max(v[1]->x, v[2]->x));
+        float minY = std::min(v[0]->y, std::min(v[1]->y, v[2]->y));
+        float maxY = std::max(v[0]->y, std::max(v[1]->y, v[2]->y));
+        // 只覆盖中心落在三角形内的像素：像素 i 的中心为 i + 0.5
+        int x0 = std::max(0, (int)std::ceil(minX - 0.5f));
+        int x1 = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+        int y0 = std::max(0, (int)std::ceil(minY - 0.5f));
+        int y1 = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        // 边 i 与顶点 i 相对，E_i 在顶点 i 处为 1、在对边上为 0（两种绕向都适用，不做背面剔除）。
+        // 坐标相对于顶点 0：用绝对像素坐标时常数项是两个大数之差，细长三角形的深度会严重失真
+        float inv = 1.0f / area;
+        tri.originX = v[0]->x;
+        tri.originY = v[0]->y;
+        for (int i = 0; i < 3; i++)
+        {
+            const ScreenVertex *p = v[(i + 1) % 3], *q = v[(i + 2) % 3];
+            float px = p->x - tri.originX, py = p->y - tri.originY;
+            float qx = q->x - tri.originX, qy = q->y - tri.originY;
+            tri.edgeA[i] = (py - qy) * inv;
+            tri.edgeB[i] = (qx - px) * inv;
+            tri.edgeC[i] = (px * qy - qx * py) * inv;
+        }
+        // NDC 深度在屏幕空间是线性的：z = z0 + E_1 (z1 - z0) + E_2 (z2 - z0)
+        float dz1 = v[1]->z - v[0]->z, dz2 = v[2]->z - v[0]->z;
+        tri.zA = tri.edgeA[1] * dz1 + tri.edgeA[2] * dz2;
+        tri.zB = tri.edgeB[1] * dz1 + tri.edgeB[2] * dz2;
+        tri.zC = v[0]->z;
+        tri.minZ = std::min(v[0]->z, std::min(v[1]->z, v[2]->z));
+        tri.x0 = x0;
+        tri.x1 = x1;
+        tri.y0 = y0;
+        tri.y1 = y1;
+
+        for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++)
+            for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++)
+                bins[ty * tilesX + tx].push_back((unsigned int)t);
+    }
+}
+
+void SoftwareRenderer::endFrame()
+{
+    PROFILE_SCOPE("Software rasterize");
+    const size_t triangleTotal = indexCount / 3;
+    if (triangles.size() < triangleTotal)
+        triangles.resize(triangleTotal);
+    triangleTotalLastFrame = triangleTotal;
+    const int tileCount = tilesX * tilesY;
+
+    // 1. 三角形建立和分桶：每个任务处理一段连续的三角形，写自己的桶，无需加锁
+    const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(parallelThreadCount() * 2, (triangleTotal + 1023) / 1024));
+    if (chunkBins.size() < chunkCount)
+        chunkBins.resize(chunkCount);
+    for (size_t c = 0; c < chunkCount; c++)
+        chunkBins[c].resize(tileCount);
+    parallelFor(0, chunkCount, 1, [&](size_t b, size_t e)
+                {
+                    for (size_t c = b; c < e; c++)
+                    {
+                        size_t begin = triangleTotal * c / chunkCount;
+                        size_t end = triangleTotal * (c + 1) / chunkCount;
+                        setupTriangles(begin, end, chunkBins[c]);
+                    }
+                });
+    for (size_t c = chunkCount; c < chunkBins.size(); c++)
+        for (auto &bin : chunkBins[c])
+            bin.clear();
+
+    // 2. 每个 tile 独立光栅化和着色
+    parallelFor(0, (size_t)tileCount, 1, [&](size_t b, size_t e)
+                {
+                    for (size_t t = b; t < e; t++)
+                        rasterizeTile((int)t);
+                });
+
+    // 变换后的顶点、三角形和分桶在帧之间复用，只会增长
+    size_t scratch = MemoryStats::bytes(vertices) + MemoryStats::bytes(indices) + MemoryStats::bytes(triangles);
+    for (const auto &bins : chunkBins)
+        for (const auto &bin : bins)
+            scratch += MemoryStats::bytes(bin);
+    if (scratch != recordedScratch)
+    {
+        MemoryStats::set(MemoryCategory::Caches, "Software rasterizer", scratch);
+        recordedScratch = scratch;
+    }
+}
+
+void SoftwareRenderer::rasterizeTile(int tile)
+{
+    // tile 内的深度和可见性缓冲在线程间复用
+    thread_local std::vector<float> depth(TILE_SIZE * TILE_SIZE);
+    thread_local std::vector<unsigned int> visible(TILE_SIZE * TILE_SIZE);
+    float blockMaxZ[BLOCKS_PER_TILE * BLOCKS_PER_TILE]; // 每个 8x8 块中最远的深度
+
+    const int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    const int tileW = std::min(TILE_SIZE, width - tileX), tileH = std::min(TILE_SIZE, height - tileY);
+
+    // 没有三角形的 tile 直接填背景色
+    bool empty = true;
+    for (size_t c = 0; c < chunkBins.size() && empty; c++)
+        empty = chunkBins[c][tile].empty();
+    if (empty)
+    {
+        for (int y = 0; y < tileH; y++)
+            std::copy(clearRow.begin(), clearRow.begin() + (size_t)tileW * channels,
+                      color.begin() + ((size_t)(tileY + y) * width + tileX) * channels);
+        return;
+    }
+
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(visible.begin(), visible.end(), NO_TRIANGLE);
+    std::fill(blockMaxZ, blockMaxZ + BLOCKS_PER_TILE * BLOCKS_PER_TILE, 1.0f);
+    float tileMaxZ = 1.0f;
+    // 还没有写入过的块数：只要有块仍是清屏深度，tile 的最远深度就是 1，不必重新统计
+    int openBlocks = BLOCKS_PER_TILE * BLOCKS_PER_TILE;
+
+    for (size_t c = 0; c < chunkBins.size(); c++)
+    {
+        for (unsigned int t : chunkBins[c][tile])
+        {
+            const Triangle &tri = triangles[t];
+            // tile 中最远的深度也比三角形最近的点近：整个三角形在这里都被遮挡
+            if (tri.minZ >= tileMaxZ)
+                continue;
+
+            int bx0 = (std::max(tri.x0, tileX) - tileX) / BLOCK_SIZE;
+            int bx1 = (std::min(tri.x1, tileX + tileW - 1) - tileX) / BLOCK_SIZE;
+            int by0 = (std::max(tri.y0, tileY) - tileY) / BLOCK_SIZE;
+            int by1 = (std::min(tri.y1, tileY + tileH - 1) - tileY) / BLOCK_SIZE;
+            bool wroteAny = false;
+
+            for (int by = by0; by <= by1; by++)
+            {
+                for (int bx = bx0; bx <= bx1; bx++)
+                {
+                    float &blockMax = blockMaxZ[by * BLOCKS_PER_TILE + bx];
+                    if (tri.minZ >= blockMax)
+                        continue;
+
+                    // 块的像素中心范围
+                    const int px0 = tileX + bx * BLOCK_SIZE, py0 = tileY + by * BLOCK_SIZE;
+                    const float cx0 = px0 + 0.5f - tri.originX, cy0 = py0 + 0.5f - tri.originY;
+                    const float cx1 = cx0 + BLOCK_SIZE - 1, cy1 = cy0 + BLOCK_SIZE - 1;
+
+                    // 任一条边在整个块上都为负：块在三角形外
+                    bool outside = false;
+                    for (int i = 0; i < 3 && !outside; i++)
+                    {
+                        float best = tri.edgeA[i] * (tri.edgeA[i] > 0 ? cx1 : cx0) +
+                                     tri.edgeB[i] * (tri.edgeB[i] > 0 ? cy1 : cy0) + tri.edgeC[i];
+                        outside = best < 0.0f;
+                    }
+                    if (outside)
+                        continue;
+
+                    const int w = std::min(BLOCK_SIZE, tileX + tileW - px0);
+                    const int h = std::min(BLOCK_SIZE, tileY + tileH - py0);
+                    bool wrote = false;
+                    for (int y = 0; y < h; y++)
+                    {
+                        const float fy = cy0 + y;
+                        float e0 = tri.edgeA[0] * cx0 + tri.edgeB[0] * fy + tri.edgeC[0];
+                        float e1 = tri.edgeA[1] * cx0 + tri.edgeB[1] * fy + tri.edgeC[1];
+                        float e2 = tri.edgeA[2] * cx0 + tri.edgeB[2] * fy + tri.edgeC[2];
+                        float z = tri.zA * cx0 + tri.zB * fy + tri.zC;
+                        const int row = (py0 - tileY + y) * TILE_SIZE + (px0 - tileX);
+                        for (int x = 0; x < w; x++)
+                        {
+                            if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f && z >= 0.0f && z < depth[row + x])
+                            {
+                                depth[row + x] = z;
+                                visible[row + x] = t;
+                                wrote = true;
+                            }
+                            e0 += tri.edgeA[0];
+                            e1 += tri.edgeA[1];
+                            e2 += tri.edgeA[2];
+                            z += tri.zA;
+                        }
+                    }
+
+                    if (wrote)
+                    {
+                        float m = 0.0f;
+                        for (int y = 0; y < h; y++)
+                        {
+                            const int row = (py0 - tileY + y) * TILE_SIZE + (px0 - tileX);
+                            for (int x = 0; x < w; x++)
+                                m = std::max(m, depth[row + x]);
+                        }
+                        if (blockMax >= 1.0f)
+                            openBlocks--;
+                        blockMax = m;
+                        wroteAny = true;
+                    }
+                }
+            }
+
+            if (wroteAny && openBlocks == 0)
+                tileMaxZ = *std::max_element(blockMaxZ, blockMaxZ + BLOCKS_PER_TILE * BLOCKS_PER_TILE);
+        }
+    }
+
+    shadeTile(tile, visible);
+}
+
+void SoftwareRenderer::storeColor(size_t pixel, const glm::vec3 &rgb)
+{
+    unsigned char *dst = &color[pixel * channels];
+    dst[0] = toByte(rgb.r);
+    dst[1] = toByte(rgb.g);
+    dst[2] = toByte(rgb.b);
+    if (channels == 4)
+        dst[3] = 255;
+}
+
+void SoftwareRenderer::shadeTile(int tile, const std::vector<unsigned int> &visible)
+{
+    const int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    const int tileW = std::min(TILE_SIZE, width - tileX), tileH = std::min(TILE_SIZE, height - tileY);
+
+    const glm::vec3 toLight = glm::normalize(-lightDir);
+    const glm::vec3 ambient = 0.3f * lightColor;
+
+    for (int y = 0; y < tileH; y++)
+    {
+        for (int x = 0; x < tileW; x++)
+        {
+            const size_t pixel = (size_t)(tileY + y) * width + tileX + x;
+            unsigned int t = visible[y * TILE_SIZE + x];
+            if (t == NO_TRIANGLE)
+            {
+                std::copy(clearRow.begin(), clearRow.begin() + channels, color.begin() + pixel * channels);
+                continue;
+            }
+
+            // 屏幕空间重心坐标 -> 透视校正的重心坐标
+            const Triangle &tri = triangles[t];
+            const float fx = tileX + x + 0.5f - tri.originX, fy = tileY + y + 0.5f - tri.originY;
+            const ScreenVertex &a = vertices[tri.v[0]], &b = vertices[tri.v[1]], &c = vertices[tri.v[2]];
+            float l0 = (tri.edgeA[0] * fx + tri.edgeB[0] * fy + tri.edgeC[0]) * a.invW;
+            float l1 = (tri.edgeA[1] * fx + tri.edgeB[1] * fy + tri.edgeC[1]) * b.invW;
+            float l2 = (tri.edgeA[2] * fx + tri.edgeB[2] * fy + tri.edgeC[2]) * c.invW;
+            float inv = 1.0f / (l0 + l1 + l2);
+            l0 *= inv;
+            l1 *= inv;
+            l2 *= inv;
+
+            glm::vec3 fragPos = a.world * l0 + b.world * l1 + c.world * l2;
+            glm::vec3 normal = a.normal * l0 + b.normal * l1 + c.normal * l2;
+
+            // 与 skinning.frag 相同的 Phong 光照
+            glm::vec3 norm = glm::normalize(normal);
+            float diff = std::max(glm::dot(norm, toLight), 0.0f);
+            glm::vec3 viewDir = glm::normalize(viewPos - fragPos);
+            glm::vec3 reflectDir = glm::reflect(-toLight, norm);
+            float spec = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), 32.0f);
+            glm::vec3 result = ambient + diff * lightColor + spec * lightColor * 0.5f;
+            storeColor(pixel, result);
+        }
+    }
+}
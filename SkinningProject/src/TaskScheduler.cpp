@@ -0,0 +1,381 @@
+#include "TaskScheduler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace
+{
+    std::mutex instanceMutex;
+    std::atomic<TaskScheduler *> current{nullptr};
+    std::atomic<uint64_t> generations{0};
+
+    // 当前线程在哪个调度器（按 generation 区分）的哪个槽位上
+    thread_local uint64_t threadGeneration = 0;
+    thread_local int threadSlot = -1;
+}
+
+TaskScheduler &TaskScheduler::instance()
+{
+    TaskScheduler *scheduler = current.load(std::memory_order_acquire);
+    if (scheduler)
+        return *scheduler;
+
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    scheduler = current.load(std::memory_order_relaxed);
+    if (!scheduler)
+    {
+        scheduler = new TaskScheduler(parallelThreadCount());
+        current.store(scheduler, std::memory_order_release);
+    }
+    return *scheduler;
+}
+
+void TaskScheduler::shutdown()
+{
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    delete current.exchange(nullptr);
+}
+
+TaskScheduler::TaskScheduler(unsigned int threadLimit)
+    : generation(++generations), parallelism(std::max(1u, threadLimit))
+{
+    // 调用线程占一个并行度；后台任务（编码、写盘）由 IO 线程执行，单核时也能与渲染重叠
+    const unsigned int workerThreads = parallelism - 1;
+    for (unsigned int i = 0; i <= workerThreads; i++)
+        workers.push_back(std::make_unique<Worker>());
+
+    threadGeneration = generation;
+    threadSlot = 0;
+    for (unsigned int i = 1; i <= workerThreads; i++)
+        threads.emplace_back(&TaskScheduler::workerLoop, this, (int)i);
+    ioThread = std::thread(&TaskScheduler::ioLoop, this);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(io.mutex);
+        ioWake.notify_all();
+    }
+    for (auto &t : threads)
+        t.join();
+    ioThread.join();
+
+    // 0 号槽位的线程继续存活，以后可能属于新的调度器
+    if (threadGeneration == generation)
+        threadSlot = -1;
+}
+
+int TaskScheduler::currentSlot() const
+{
+    return threadGeneration == generation ? threadSlot : -1;
+}
+
+TaskRef TaskScheduler::submit(std::function<void()> fn, const std::vector<TaskRef> &dependencies, TaskKind kind)
+{
+    TaskRef task = std::make_shared<Task>();
+    task->fn = std::move(fn);
+    task->kind = kind;
+    for (const TaskRef &dependency : dependencies)
+    {
+        if (!dependency)
+            continue;
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->finished.load(std::memory_order_relaxed))
+            continue;
+        task->pending.fetch_add(1, std::memory_order_relaxed);
+        dependency->successors.push_back(task);
+    }
+
+    // 去掉提交过程中的保护计数；依赖都已完成时立即入队
+    if (task->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        enqueue(task);
+    return task;
+}
+
+void TaskScheduler::enqueue(TaskRef task)
+{
+    // IO 任务不进任何线程的双端队列，只有 IO 线程会取
+    if (task->kind == TaskKind::IO)
+    {
+        std::lock_guard<std::mutex> lock(io.mutex);
+        io.queue.push_back(std::move(task));
+        ioWake.notify_one();
+        return;
+    }
+
+    const int slot = currentSlot();
+    if (slot >= 0)
+    {
+        std::lock_guard<std::mutex> lock(workers[slot]->mutex);
+        workers[slot]->queue.push_back(std::move(task));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injection.push_back(std::move(task));
+    }
+
+    // 先入队再计数：睡眠的线程在持锁检查 queued 之后才会真正睡下，不会错过唤醒
+    queued.fetch_add(1);
+    if (sleepers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+}
+
+TaskRef TaskScheduler::findWork(int slot)
+{
+    if (queued.load() == 0)
+        return nullptr;
+
+    TaskRef task;
+    // 1. 自己队列的尾部：最近提交的任务，数据多半还在缓存里
+    if (slot >= 0)
+    {
+        Worker &self = *workers[slot];
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.queue.empty())
+        {
+            task = std::move(self.queue.back());
+            self.queue.pop_back();
+        }
+    }
+
+    // 2. 外部线程提交的任务
+    if (!task)
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if (!injection.empty())
+        {
+            task = std::move(injection.front());
+            injection.pop_front();
+        }
+    }
+
+    // 3. 从其他线程队列的头部偷，从下一个槽位开始轮询，避免所有线程都去偷同一个
+    if (!task)
+    {
+        const size_t count = workers.size();
+        const size_t start = slot >= 0 ? (size_t)slot + 1 : 0;
+        for (size_t i = 0; i < count && !task; i++)
+        {
+            size_t victim = (start + i) % count;
+            if ((int)victim == slot)
+                continue;
+            Worker &other = *workers[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.queue.empty())
+            {
+                task = std::move(other.queue.front());
+                other.queue.pop_front();
+            }
+        }
+        if (task && slot >= 0)
+            workers[slot]->steals.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (task)
+        queued.fetch_sub(1);
+    return task;
+}
+
+void TaskScheduler::execute(const TaskRef &task, Worker *owner)
+{
+    task->fn();
+    task->fn = nullptr; // 尽早释放捕获的资源
+    if (owner)
+        owner->tasks.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<TaskRef> successors;
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->finished.store(true);
+        successors.swap(task->successors);
+    }
+    for (TaskRef &successor : successors)
+        if (successor->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            enqueue(std::move(successor));
+
+    // 可能有线程在等这个任务
+    if (sleepers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+}
+
+void TaskScheduler::idle(Worker *owner, const std::function<bool()> &ready)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [&]
+                  { return stopping.load() || ready(); });
+        sleepers.fetch_sub(1);
+    }
+    if (owner)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        owner->idleNanoseconds.fetch_add(
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+    }
+}
+
+void TaskScheduler::workerLoop(int slot)
+{
+    threadGeneration = generation;
+    threadSlot = slot;
+    for (;;)
+    {
+        if (TaskRef task = findWork(slot))
+        {
+            execute(task, workers[slot].get());
+            continue;
+        }
+        // 退出前先把队列里剩下的任务做完
+        if (stopping.load())
+            return;
+        idle(workers[slot].get(), [&]
+             { return queued.load() > 0; });
+    }
+}
+
+void TaskScheduler::ioLoop()
+{
+    for (;;)
+    {
+        TaskRef task;
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(io.mutex);
+            ioWake.wait(lock, [&]
+                        { return stopping.load() || !io.queue.empty(); });
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            io.idleNanoseconds.fetch_add(
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                std::memory_order_relaxed);
+            // 退出前先把队列里剩下的任务做完
+            if (io.queue.empty())
+                return;
+            task = std::move(io.queue.front());
+            io.queue.pop_front();
+        }
+        execute(task, &io);
+    }
+}
+
+void TaskScheduler::wait(const TaskRef &task)
+{
+    if (!task)
+        return;
+    const int slot = currentSlot();
+    Worker *owner = slot >= 0 ? workers[slot].get() : nullptr;
+
+    // IO 任务在 IO 线程上按顺序执行，帮不上忙；也不去执行别的任务，免得等待者被一个慢任务拖住
+    if (task->kind == TaskKind::IO)
+    {
+        while (!task->done())
+            idle(owner, [&]
+                 { return task->done(); });
+        return;
+    }
+
+    while (!task->done())
+    {
+        if (TaskRef other = findWork(slot))
+            execute(other, owner);
+        else
+            idle(owner, [&]
+                 { return task->done() || queued.load() > 0; });
+    }
+}
+
+void TaskScheduler::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &fn)
+{
+    if (end <= begin)
+        return;
+
+    // 块数取线程数的几倍，负载不均时快的线程可以偷走剩下的块
+    const size_t count = end - begin;
+    grain = std::max<size_t>(grain, 1);
+    const size_t pieces = std::min<size_t>((count + grain - 1) / grain, (size_t)parallelism * 4);
+    if (pieces <= 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    // 块由参与的线程按序号领取：调用线程和最多每个工作线程一个辅助任务。
+    // 调用线程只领这次循环的块，领完后睡眠等别人手上的块，不会去执行队列里无关的任务（比如其他循环）。
+    // 块全部领完后才开始执行的辅助任务什么也不做，所以只有 progress 放在堆上，fn 在块全部完成前一直有效
+    struct Progress
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> finished{0};
+    };
+    auto progress = std::make_shared<Progress>();
+    auto runPieces = [begin, count, pieces](Progress &state, const std::function<void(size_t, size_t)> &body)
+    {
+        for (size_t p; (p = state.next.fetch_add(1)) < pieces;)
+        {
+            body(begin + count * p / pieces, begin + count * (p + 1) / pieces);
+            state.finished.fetch_add(1);
+        }
+    };
+
+    const size_t helpers = std::min(pieces - 1, threads.size());
+    for (size_t i = 0; i < helpers; i++)
+        submit([progress, runPieces, &fn]()
+               { runPieces(*progress, fn); });
+    runPieces(*progress, fn);
+
+    const int slot = currentSlot();
+    Worker *owner = slot >= 0 ? workers[slot].get() : nullptr;
+    while (progress->finished.load() < pieces)
+        idle(owner, [&]
+             { return progress->finished.load() >= pieces; });
+}
+
+std::vector<SchedulerStats> TaskScheduler::stats() const
+{
+    std::vector<SchedulerStats> result;
+    for (const auto &worker : workers)
+        result.push_back({worker->tasks.load(), worker->steals.load(), worker->idleNanoseconds.load() * 1e-9});
+    result.push_back({io.tasks.load(), io.steals.load(), io.idleNanoseconds.load() * 1e-9});
+    return result;
+}
+
+void TaskScheduler::resetStats()
+{
+    for (auto &worker : workers)
+    {
+        worker->tasks = 0;
+        worker->steals = 0;
+        worker->idleNanoseconds = 0;
+    }
+    io.tasks = 0;
+    io.idleNanoseconds = 0;
+}
+
+void TaskScheduler::printStats(std::ostream &out) const
+{
+    out << "Task scheduler: " << workers.size() << " threads + io (parallelism " << parallelism << ")" << std::endl;
+    std::vector<SchedulerStats> all = stats();
+    for (size_t i = 0; i < all.size(); i++)
+    {
+        const std::string name = i == 0 ? "main    " : i + 1 == all.size() ? "io      " : "worker " + std::to_string(i);
+        out << "  " << name << "  tasks " << std::setw(8)
+            << all[i].tasks << "  steals " << std::setw(7) << all[i].steals << "  idle " << std::fixed
+            << std::setprecision(3) << all[i].idleSeconds << " s" << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+}
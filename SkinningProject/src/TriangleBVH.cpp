@@ -0,0 +1,487 @@
+#include "TriangleBVH.h"
+#include "MemoryStats.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const int LEAF_SIZE = 4;        // 不超过这个数时直接做叶子
+    const int MAX_LEAF_SIZE = 16;   // SAH 认为不值得再分时，叶子最多容纳的三角形数
+    const int BINS = 16;            // SAH 分箱数
+    const int BALANCED_DEPTH = 40;  // 超过这个深度改用中位数划分，保证树深有上限
+    const int SUBTREE_DEPTH = 6;    // 并行 refit 时按这一层切成最多 64 棵子树
+    const int STACK_SIZE = 96;      // 遍历栈：树深不超过 BALANCED_DEPTH + log2(三角形数)
+    const float TRAVERSAL_COST = 1.0f; // SAH：访问一个内部节点相对于测试一个三角形的代价
+
+    float surfaceArea(const BoundingBox &box)
+    {
+        if (box.empty())
+            return 0.0f;
+        glm::vec3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    float distanceSquared(const BoundingBox &box, const glm::vec3 &p)
+    {
+        glm::vec3 d = glm::max(glm::max(box.min - p, p - box.max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    // 射线与包围盒的进入距离，不相交时返回 +inf
+    float slab(const BoundingBox &box, const glm::vec3 &origin, const glm::vec3 &invDir, float tMax)
+    {
+        glm::vec3 t0 = (box.min - origin) * invDir;
+        glm::vec3 t1 = (box.max - origin) * invDir;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+        return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+    }
+
+    // Möller–Trumbore，双面
+    bool intersectTriangle(const Ray &ray, const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2,
+                           float &t, float &u, float &v)
+    {
+        glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+        glm::vec3 pv = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, pv);
+        if (std::abs(det) < 1e-12f)
+            return false;
+        float inv = 1.0f / det;
+        glm::vec3 tv = ray.origin - p0;
+        u = glm::dot(tv, pv) * inv;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 qv = glm::cross(tv, e1);
+        v = glm::dot(ray.direction, qv) * inv;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = glm::dot(e2, qv) * inv;
+        return t >= 0.0f;
+    }
+
+    // 三角形上离 p 最近的点（Ericson，Real-Time Collision Detection 5.1.5）
+    glm::vec3 closestOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+}
+
+void TriangleBVH::build(const Mesh &mesh)
+{
+    SkinnedVertices rest;
+    rest.count = mesh.vertices.size();
+    for (auto *v : {&rest.px, &rest.py, &rest.pz})
+        v->resize(rest.count);
+    for (size_t i = 0; i < rest.count; i++)
+    {
+        rest.px[i] = mesh.vertices[i].position.x;
+        rest.py[i] = mesh.vertices[i].position.y;
+        rest.pz[i] = mesh.vertices[i].position.z;
+    }
+    build(mesh.indices, rest);
+}
+
+void TriangleBVH::build(const std::vector<unsigned int> &triangleIndices, const SkinnedVertices &vertices)
+{
+    PROFILE_SCOPE("BVH build");
+    indices.assign(triangleIndices.begin(), triangleIndices.end() - triangleIndices.size() % 3);
+    triangleBoxes.resize(indices.size() / 3);
+    nodes.clear();
+    rebuilds = 0;
+    refit(vertices); // 读入位置并计算三角形包围盒；树为空时 refit 只做这一步
+    rebuild();
+
+    MemoryStats::set(MemoryCategory::Caches, "Triangle BVH",
+                     MemoryStats::bytes(indices) + MemoryStats::bytes(positions) + MemoryStats::bytes(triangleBoxes) +
+                         MemoryStats::bytes(centroids) + MemoryStats::bytes(order) + MemoryStats::bytes(nodes));
+}
+
+void TriangleBVH::rebuild()
+{
+    const int triangles = (int)triangleBoxes.size();
+    centroids.resize(triangles);
+    order.resize(triangles);
+    for (int t = 0; t < triangles; t++)
+    {
+        centroids[t] = (triangleBoxes[t].min + triangleBoxes[t].max) * 0.5f;
+        order[t] = t;
+    }
+
+    nodes.clear();
+    nodes.reserve(std::max(1, 2 * triangles / LEAF_SIZE));
+    subtrees.clear();
+    topNodes.clear();
+    if (triangles > 0)
+        buildNode(0, triangles, 0);
+
+    buildCost = currentCost = computeCost();
+}
+
+int TriangleBVH::buildNode(int first, int count, int depth)
+{
+    const int index = (int)nodes.size();
+    nodes.push_back({BoundingBox(), first, count});
+
+    BoundingBox box, centroidBox;
+    for (int i = first; i < first + count; i++)
+    {
+        box.expand(triangleBoxes[order[i]]);
+        centroidBox.expand(centroids[order[i]]);
+    }
+    nodes[index].box = box;
+
+    // 到达切分深度的节点（或更浅的叶子）各自成为一棵并行 refit 的子树
+    const bool subtreeRoot = depth == SUBTREE_DEPTH || (depth < SUBTREE_DEPTH && count <= LEAF_SIZE);
+    if (depth < SUBTREE_DEPTH && !subtreeRoot)
+        topNodes.push_back(index);
+
+    if (count <= LEAF_SIZE)
+    {
+        if (subtreeRoot)
+            subtrees.push_back({index, index + 1});
+        return index;
+    }
+
+    glm::vec3 extent = centroidBox.max - centroidBox.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int split = -1; // 左边的三角形数
+
+    if (extent[axis] > 0.0f && depth < BALANCED_DEPTH)
+    {
+        // 分箱 SAH：按质心落入的箱子统计，枚举 BINS - 1 个切分位置
+        BoundingBox binBoxes[BINS];
+        int binCounts[BINS] = {};
+        const float scale = BINS / extent[axis];
+        auto binOf = [&](int t)
+        { return std::min(BINS - 1, (int)((centroids[t][axis] - centroidBox.min[axis]) * scale)); };
+        for (int i = first; i < first + count; i++)
+        {
+            int b = binOf(order[i]);
+            binBoxes[b].expand(triangleBoxes[order[i]]);
+            binCounts[b]++;
+        }
+
+        float rightAreas[BINS];
+        int rightCounts[BINS];
+        BoundingBox accum;
+        int accumCount = 0;
+        for (int b = BINS - 1; b > 0; b--)
+        {
+            accum.expand(binBoxes[b]);
+            accumCount += binCounts[b];
+            rightAreas[b] = surfaceArea(accum);
+            rightCounts[b] = accumCount;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        int bestBin = -1;
+        accum = BoundingBox();
+        accumCount = 0;
+        for (int b = 0; b < BINS - 1; b++)
+        {
+            accum.expand(binBoxes[b]);
+            accumCount += binCounts[b];
+            if (accumCount == 0 || rightCounts[b + 1] == 0)
+                continue;
+            float cost = surfaceArea(accum) * accumCount + rightAreas[b + 1] * rightCounts[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestBin = b;
+            }
+        }
+
+        // 划分的代价不比直接做叶子低，而且三角形不多时就不再分
+        const float area = surfaceArea(box);
+        const float splitCost = TRAVERSAL_COST + (area > 0.0f ? bestCost / area : 0.0f);
+        if (bestBin >= 0 && splitCost >= count && count <= MAX_LEAF_SIZE)
+        {
+            if (subtreeRoot)
+                subtrees.push_back({index, index + 1});
+            return index;
+        }
+        if (bestBin >= 0)
+        {
+            int *middle = std::partition(order.data() + first, order.data() + first + count,
+                                         [&](int t) { return binOf(t) <= bestBin; });
+            split = (int)(middle - (order.data() + first));
+        }
+    }
+
+    // 质心重合或深度过大时按中位数对半分
+    if (split <= 0 || split >= count)
+    {
+        split = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + split, order.begin() + first + count,
+                         [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    nodes[index].count = 0;
+    buildNode(first, split, depth + 1);
+    int right = buildNode(first + split, count - split, depth + 1);
+    nodes[index].right = right;
+
+    if (subtreeRoot)
+        subtrees.push_back({index, (int)nodes.size()});
+    return index;
+}
+
+bool TriangleBVH::refit(const SkinnedVertices &vertices)
+{
+    PROFILE_SCOPE("BVH refit");
+    positions.resize(vertices.count);
+    parallelFor(0, vertices.count, 8192, [&](size_t b, size_t e)
+                {
+                    for (size_t i = b; i < e; i++)
+                        positions[i] = vertices.position(i);
+                });
+
+    const size_t vertexCount = positions.size();
+    parallelFor(0, triangleBoxes.size(), 4096, [&](size_t b, size_t e)
+                {
+                    for (size_t t = b; t < e; t++)
+                    {
+                        BoundingBox box;
+                        for (int k = 0; k < 3; k++)
+                        {
+                            unsigned int i = indices[3 * t + k];
+                            if (i < vertexCount)
+                                box.expand(positions[i]);
+                        }
+                        triangleBoxes[t] = box;
+                    }
+                });
+    if (nodes.empty())
+        return false;
+
+    // 子树互不相交，并行自底向上；然后串行更新子树之上的几层
+    parallelFor(0, subtrees.size(), 1, [&](size_t b, size_t e)
+                {
+                    for (size_t s = b; s < e; s++)
+                        refitRange(subtrees[s].first, subtrees[s].second);
+                });
+    for (auto it = topNodes.rbegin(); it != topNodes.rend(); ++it)
+        refitNode(*it);
+
+    currentCost = computeCost();
+    if (currentCost <= buildCost * rebuildRatio)
+        return false;
+
+    PROFILE_SCOPE("BVH rebuild");
+    rebuild();
+    rebuilds++;
+    return true;
+}
+
+void TriangleBVH::refitRange(int begin, int end)
+{
+    // 先序存放，孩子的下标总是比父节点大：倒序处理即为自底向上
+    for (int i = end - 1; i >= begin; i--)
+        refitNode(i);
+}
+
+void TriangleBVH::refitNode(int index)
+{
+    Node &node = nodes[index];
+    BoundingBox box;
+    if (node.count > 0)
+    {
+        for (int i = node.right; i < node.right + node.count; i++)
+            box.expand(triangleBoxes[order[i]]);
+    }
+    else
+    {
+        box = nodes[index + 1].box;
+        box.expand(nodes[node.right].box);
+    }
+    node.box = box;
+}
+
+float TriangleBVH::computeCost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+    const float rootArea = surfaceArea(nodes[0].box);
+    if (rootArea <= 0.0f)
+        return 0.0f;
+
+    double cost = 0.0;
+    for (const Node &node : nodes)
+        cost += surfaceArea(node.box) * (node.count > 0 ? (float)node.count : TRAVERSAL_COST);
+    return (float)(cost / rootArea);
+}
+
+void TriangleBVH::triangle(int t, glm::vec3 &p0, glm::vec3 &p1, glm::vec3 &p2) const
+{
+    p0 = positions[indices[3 * t]];
+    p1 = positions[indices[3 * t + 1]];
+    p2 = positions[indices[3 * t + 2]];
+}
+
+bool TriangleBVH::raycast(const Ray &ray, float tMax, RayHit &hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    const glm::vec3 invDir = 1.0f / ray.direction; // 分量为 0 时得到 inf，slab 仍然正确
+    hit.triangle = -1;
+    float closest = tMax;
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    if (slab(nodes[0].box, ray.origin, invDir, closest) < std::numeric_limits<float>::infinity())
+        stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes[stack[--top]];
+        if (slab(node.box, ray.origin, invDir, closest) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (node.count > 0)
+        {
+            for (int i = node.right; i < node.right + node.count; i++)
+            {
+                glm::vec3 p0, p1, p2;
+                triangle(order[i], p0, p1, p2);
+                float t, u, v;
+                if (intersectTriangle(ray, p0, p1, p2, t, u, v) && t < closest)
+                {
+                    closest = t;
+                    hit = {order[i], t, u, v};
+                }
+            }
+            continue;
+        }
+
+        // 近的孩子后入栈，先访问
+        int left = (int)(&node - nodes.data()) + 1, right = node.right;
+        float tLeft = slab(nodes[left].box, ray.origin, invDir, closest);
+        float tRight = slab(nodes[right].box, ray.origin, invDir, closest);
+        if (tLeft > tRight)
+        {
+            std::swap(left, right);
+            std::swap(tLeft, tRight);
+        }
+        if (tRight < std::numeric_limits<float>::infinity())
+            stack[top++] = right;
+        if (tLeft < std::numeric_limits<float>::infinity())
+            stack[top++] = left;
+    }
+    return hit.triangle >= 0;
+}
+
+bool TriangleBVH::closestPoint(const glm::vec3 &p, float maxDistance, PointHit &hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    hit.triangle = -1;
+    float best = maxDistance * maxDistance;
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const int index = stack[--top];
+        const Node &node = nodes[index];
+        if (distanceSquared(node.box, p) > best)
+            continue;
+
+        if (node.count > 0)
+        {
+            for (int i = node.right; i < node.right + node.count; i++)
+            {
+                if (distanceSquared(triangleBoxes[order[i]], p) > best)
+                    continue;
+                glm::vec3 p0, p1, p2;
+                triangle(order[i], p0, p1, p2);
+                glm::vec3 q = closestOnTriangle(p, p0, p1, p2);
+                float d = glm::dot(q - p, q - p);
+                if (d <= best)
+                {
+                    best = d;
+                    hit.triangle = order[i];
+                    hit.point = q;
+                }
+            }
+            continue;
+        }
+
+        int left = index + 1, right = node.right;
+        float dLeft = distanceSquared(nodes[left].box, p), dRight = distanceSquared(nodes[right].box, p);
+        if (dLeft > dRight)
+        {
+            std::swap(left, right);
+            std::swap(dLeft, dRight);
+        }
+        if (dRight <= best)
+            stack[top++] = right;
+        if (dLeft <= best)
+            stack[top++] = left;
+    }
+
+    if (hit.triangle < 0)
+        return false;
+    hit.distance = std::sqrt(best);
+    return true;
+}
+
+void TriangleBVH::query(const BoundingBox &box, std::vector<int> &triangles) const
+{
+    if (nodes.empty() || box.empty())
+        return;
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const int index = stack[--top];
+        const Node &node = nodes[index];
+        if (!node.box.overlaps(box))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (int i = node.right; i < node.right + node.count; i++)
+                if (triangleBoxes[order[i]].overlaps(box))
+                    triangles.push_back(order[i]);
+            continue;
+        }
+        stack[top++] = node.right;
+        stack[top++] = index + 1;
+    }
+}
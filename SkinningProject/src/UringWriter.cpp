@@ -0,0 +1,344 @@
+#include "UringWriter.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAS_IO_URING
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+UringWriter::UringWriter(const std::string &p, int w, int h, int frames, int bufferCount, bool directIO)
+    : path(p), width(w), height(h), frameCount(frames), direct(directIO), fd(-1),
+      inFlight(0), failed(false), ringFd(-1), sqRing(nullptr), cqRing(nullptr), sqeMemory(nullptr),
+      sqRingSize(0), cqRingSize(0), sqeMemorySize(0), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr),
+      sqArray(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), sqes(nullptr), cqes(nullptr)
+{
+    frameBytes = (size_t)width * height * 3;
+    stride = direct ? alignUp(frameBytes, ALIGNMENT) : frameBytes;
+    buffers.resize(std::max(1, bufferCount));
+}
+
+UringWriter::~UringWriter()
+{
+    finish();
+    close();
+}
+
+const char *UringWriter::describe() const
+{
+    return path.c_str();
+}
+
+#ifdef HAS_IO_URING
+
+bool UringWriter::isAvailable()
+{
+    return true;
+}
+
+bool UringWriter::setupRing(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ringFd < 0)
+    {
+        std::cerr << "io_uring_setup failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // 5.4 以后的内核可以用一次 mmap 同时映射提交环和完成环
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        std::cerr << "Failed to map io_uring submission ring" << std::endl;
+        return false;
+    }
+    if (singleMap)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            std::cerr << "Failed to map io_uring completion ring" << std::endl;
+            return false;
+        }
+    }
+
+    sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+    sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqeMemory == MAP_FAILED)
+    {
+        sqeMemory = nullptr;
+        std::cerr << "Failed to map io_uring submission entries" << std::endl;
+        return false;
+    }
+
+    char *sq = (char *)sqRing;
+    sqHead = (unsigned *)(sq + params.sq_off.head);
+    sqTail = (unsigned *)(sq + params.sq_off.tail);
+    sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *)(sq + params.sq_off.array);
+    sqes = sqeMemory;
+
+    char *cq = (char *)cqRing;
+    cqHead = (unsigned *)(cq + params.cq_off.head);
+    cqTail = (unsigned *)(cq + params.cq_off.tail);
+    cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+bool UringWriter::open(bool create)
+{
+    // 在飞的写请求数不超过缓冲数，提交环不会溢出
+    if (!setupRing((unsigned)buffers.size()))
+        return false;
+
+    int flags = create ? (O_WRONLY | O_CREAT | O_TRUNC) : O_WRONLY;
+    if (direct)
+    {
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0)
+        {
+            // tmpfs 等文件系统不支持 O_DIRECT
+            std::cerr << "O_DIRECT not supported for " << path << ", using buffered writes" << std::endl;
+            direct = false;
+        }
+    }
+    if (fd < 0)
+        fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open raw output " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 一次预分配整个文件，避免写入过程中反复扩展文件
+    uint64_t totalSize = HEADER_SIZE + (uint64_t)stride * frameCount;
+    if (create && fallocate(fd, 0, 0, (off_t)totalSize) != 0 && ftruncate(fd, (off_t)totalSize) != 0)
+    {
+        std::cerr << "Failed to preallocate " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 缓冲按 4096 对齐，满足 O_DIRECT 的要求；长度按帧间距分配
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        void *data = nullptr;
+        if (posix_memalign(&data, ALIGNMENT, std::max(stride, HEADER_SIZE)) != 0)
+        {
+            std::cerr << "Failed to allocate frame buffer" << std::endl;
+            return false;
+        }
+        buffers[i].data = (unsigned char *)data;
+        buffers[i].iov = new iovec();
+        freeBuffers.push_back((int)i);
+    }
+    MemoryStats::set(MemoryCategory::FrameBuffers, "io_uring frame buffers", buffers.size() * std::max(stride, HEADER_SIZE));
+
+    if (!create)
+        return true;
+
+    // 头部也通过 ring 写出，使用第一块缓冲
+    int headerBuffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    Buffer &buffer = buffers[headerBuffer];
+    std::memset(buffer.data, 0, HEADER_SIZE);
+    RawContainerHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "ATCARAW1", 8);
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.channels = 3;
+    header.frameCount = (uint32_t)frameCount;
+    header.frameBytes = frameBytes;
+    header.frameStride = stride;
+    header.dataOffset = HEADER_SIZE;
+    std::memcpy(buffer.data, &header, sizeof(header));
+    buffer.frame = -1;
+    buffer.length = HEADER_SIZE;
+    submit(headerBuffer, 0);
+    return true;
+}
+
+void UringWriter::submit(int index, uint64_t offset)
+{
+    Buffer &buffer = buffers[index];
+    buffer.iov->iov_base = buffer.data;
+    buffer.iov->iov_len = buffer.length;
+
+    // 只有渲染线程提交，尾指针可以直接读；写回尾指针时需要 release，保证内核先看到 SQE
+    unsigned tail = *sqTail;
+    unsigned slot = tail & *sqMask;
+    io_uring_sqe *sqe = (io_uring_sqe *)sqes + slot;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV; // 5.1 起就支持，比 IORING_OP_WRITE 兼容更老的内核
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t)(uintptr_t)buffer.iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)index;
+    sqArray[slot] = slot;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    inFlight++;
+    if (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0) < 0)
+    {
+        std::cerr << "io_uring_enter failed: " << std::strerror(errno) << std::endl;
+        failed = true;
+    }
+}
+
+void UringWriter::reap(bool wait)
+{
+    for (;;)
+    {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head != tail)
+        {
+            for (; head != tail; head++)
+            {
+                const io_uring_cqe &cqe = ((const io_uring_cqe *)cqes)[head & *cqMask];
+                Buffer &buffer = buffers[(size_t)cqe.user_data];
+                if (cqe.res < 0 || (size_t)cqe.res != buffer.length)
+                {
+                    std::cerr << "Raw write of frame " << buffer.frame << " failed: "
+                              << (cqe.res < 0 ? std::strerror(-cqe.res) : "short write") << std::endl;
+                    failed = true;
+                }
+                buffer.frame = -1;
+                freeBuffers.push_back((int)cqe.user_data);
+                inFlight--;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            return;
+        }
+        if (!wait || inFlight == 0)
+            return;
+        if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+        {
+            std::cerr << "io_uring_enter failed: " << std::strerror(errno) << std::endl;
+            failed = true;
+            return;
+        }
+    }
+}
+
+void UringWriter::writeFrame(int frame, const unsigned char *pixels)
+{
+    PROFILE_SCOPE("Raw write frame");
+    if (fd < 0 || failed || frame < 0 || frame >= frameCount)
+        return;
+
+    // 先收掉已完成的写；缓冲池空了就等最早的一个完成
+    reap(false);
+    while (freeBuffers.empty() && !failed)
+        reap(true);
+    if (failed)
+        return;
+
+    int index = freeBuffers.back();
+    freeBuffers.pop_back();
+    Buffer &buffer = buffers[index];
+    std::memcpy(buffer.data, pixels, frameBytes);
+    if (stride > frameBytes)
+        std::memset(buffer.data + frameBytes, 0, stride - frameBytes);
+    buffer.frame = frame;
+    buffer.length = stride;
+    submit(index, HEADER_SIZE + (uint64_t)stride * frame);
+}
+
+void UringWriter::finish()
+{
+    if (ringFd < 0)
+        return;
+    while (inFlight > 0 && !failed)
+        reap(true);
+}
+
+void UringWriter::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+
+    // 只有在没有请求在飞时才释放缓冲（出错时宁可泄漏也不能让内核写已释放的内存）
+    if (inFlight == 0)
+    {
+        for (auto &buffer : buffers)
+        {
+            free(buffer.data);
+            delete buffer.iov;
+            buffer.data = nullptr;
+            buffer.iov = nullptr;
+        }
+        MemoryStats::set(MemoryCategory::FrameBuffers, "io_uring frame buffers", 0);
+    }
+
+    if (sqeMemory)
+        munmap(sqeMemory, sqeMemorySize);
+    if (cqRing && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing)
+        munmap(sqRing, sqRingSize);
+    sqeMemory = cqRing = sqRing = nullptr;
+    if (ringFd >= 0)
+        ::close(ringFd);
+    ringFd = -1;
+}
+
+#else
+
+bool UringWriter::isAvailable()
+{
+    return false;
+}
+
+bool UringWriter::setupRing(unsigned)
+{
+    return false;
+}
+
+bool UringWriter::open(bool)
+{
+    std::cerr << "io_uring output is not available in this build" << std::endl;
+    return false;
+}
+
+void UringWriter::submit(int, uint64_t) {}
+void UringWriter::reap(bool) {}
+void UringWriter::writeFrame(int, const unsigned char *) {}
+void UringWriter::finish() {}
+void UringWriter::close() {}
+
+#endif
@@ -0,0 +1,417 @@
+#include "VoxelSkinning.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace
+{
+    const float INF = std::numeric_limits<float>::infinity();
+
+    // 体素状态：EMPTY 为尚未确定（最终视为内部），SURFACE 为与三角形相交，OUTSIDE 为外部
+    enum VoxelState : unsigned char
+    {
+        EMPTY = 0,
+        SURFACE = 1,
+        OUTSIDE = 2
+    };
+
+    struct VoxelGrid
+    {
+        glm::vec3 origin;
+        float size;
+        glm::ivec3 dims;
+        std::vector<unsigned char> state;
+
+        size_t count() const { return (size_t)dims.x * dims.y * dims.z; }
+        size_t index(int x, int y, int z) const { return ((size_t)z * dims.y + y) * dims.x + x; }
+        bool solid(size_t i) const { return state[i] != OUTSIDE; }
+
+        glm::ivec3 cellOf(const glm::vec3 &p) const
+        {
+            glm::ivec3 c = glm::ivec3(glm::floor((p - origin) / size));
+            return glm::clamp(c, glm::ivec3(0), dims - 1);
+        }
+
+        glm::vec3 center(size_t i) const
+        {
+            int x = (int)(i % dims.x);
+            int y = (int)((i / dims.x) % dims.y);
+            int z = (int)(i / ((size_t)dims.x * dims.y));
+            return origin + (glm::vec3(x, y, z) + 0.5f) * size;
+        }
+    };
+
+    // 三角形与轴对齐立方体（中心 c，半边长 h）的分离轴测试
+    bool triangleOverlapsBox(const glm::vec3 &c, float h, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        v0 -= c;
+        v1 -= c;
+        v2 -= c;
+
+        // 包围盒的三个轴
+        for (int a = 0; a < 3; a++)
+        {
+            if (std::min({v0[a], v1[a], v2[a]}) > h || std::max({v0[a], v1[a], v2[a]}) < -h)
+                return false;
+        }
+
+        // 三角形平面
+        const glm::vec3 e[3] = {v1 - v0, v2 - v1, v0 - v2};
+        glm::vec3 n = glm::cross(e[0], e[1]);
+        if (std::abs(glm::dot(n, v0)) > h * (std::abs(n.x) + std::abs(n.y) + std::abs(n.z)))
+            return false;
+
+        // 9 个边叉积轴
+        for (int i = 0; i < 3; i++)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                glm::vec3 axis(0.0f);
+                axis[a] = 1.0f;
+                axis = glm::cross(axis, e[i]);
+                float p0 = glm::dot(v0, axis);
+                float p1 = glm::dot(v1, axis);
+                float p2 = glm::dot(v2, axis);
+                float r = h * (std::abs(axis.x) + std::abs(axis.y) + std::abs(axis.z));
+                if (std::min({p0, p1, p2}) > r || std::max({p0, p1, p2}) < -r)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    VoxelGrid voxelize(const Mesh &mesh, int resolution)
+    {
+        glm::vec3 bmin(INF), bmax(-INF);
+        for (const auto &v : mesh.vertices)
+        {
+            bmin = glm::min(bmin, v.position);
+            bmax = glm::max(bmax, v.position);
+        }
+
+        glm::vec3 extent = bmax - bmin;
+        float maxExtent = std::max({extent.x, extent.y, extent.z, 1e-4f});
+
+        // 四周各留两层空体素，保证外部泛洪可以从边界包住整个网格
+        const int pad = 2;
+        VoxelGrid grid;
+        grid.size = maxExtent / resolution;
+        grid.origin = bmin - glm::vec3(grid.size * pad);
+        grid.dims = glm::ivec3(glm::ceil(extent / grid.size)) + 2 * pad;
+        grid.dims = glm::max(grid.dims, glm::ivec3(1));
+        grid.state.assign(grid.count(), EMPTY);
+
+        // 1. 表面体素化：三角形分块并行求交，结果按块收集后合并
+        const size_t triCount = mesh.indices.size() / 3;
+        const size_t blockSize = 1024;
+        const size_t blocks = (triCount + blockSize - 1) / blockSize;
+        std::vector<std::vector<uint32_t>> hits(blocks);
+
+        parallelFor(0, blocks, 1, [&](size_t first, size_t last)
+        {
+            const float h = grid.size * 0.5f;
+            for (size_t blk = first; blk < last; blk++)
+            {
+                size_t end = std::min(triCount, (blk + 1) * blockSize);
+                for (size_t t = blk * blockSize; t < end; t++)
+                {
+                    const glm::vec3 &p0 = mesh.vertices[mesh.indices[3 * t]].position;
+                    const glm::vec3 &p1 = mesh.vertices[mesh.indices[3 * t + 1]].position;
+                    const glm::vec3 &p2 = mesh.vertices[mesh.indices[3 * t + 2]].position;
+
+                    glm::ivec3 lo = grid.cellOf(glm::min(p0, glm::min(p1, p2)));
+                    glm::ivec3 hi = grid.cellOf(glm::max(p0, glm::max(p1, p2)));
+                    for (int z = lo.z; z <= hi.z; z++)
+                        for (int y = lo.y; y <= hi.y; y++)
+                            for (int x = lo.x; x <= hi.x; x++)
+                            {
+                                size_t i = grid.index(x, y, z);
+                                if (triangleOverlapsBox(grid.center(i), h, p0, p1, p2))
+                                    hits[blk].push_back((uint32_t)i);
+                            }
+                }
+            }
+        });
+
+        for (const auto &list : hits)
+            for (uint32_t i : list)
+                grid.state[i] = SURFACE;
+
+        // 2. 从边界做 6 邻域泛洪标记外部，剩下的 EMPTY 体素即为内部。
+        //    小于一个体素的破洞会被表面体素封住；大洞会让内部漏成外部，此时退化为表面壳层
+        std::vector<uint32_t> stack;
+        auto pushOutside = [&](int x, int y, int z)
+        {
+            size_t i = grid.index(x, y, z);
+            if (grid.state[i] == EMPTY)
+            {
+                grid.state[i] = OUTSIDE;
+                stack.push_back((uint32_t)i);
+            }
+        };
+
+        const glm::ivec3 d = grid.dims;
+        for (int z = 0; z < d.z; z++)
+            for (int y = 0; y < d.y; y++)
+                for (int x = 0; x < d.x; x++)
+                {
+                    if (x == 0 || y == 0 || z == 0 || x == d.x - 1 || y == d.y - 1 || z == d.z - 1)
+                        pushOutside(x, y, z);
+                }
+
+        while (!stack.empty())
+        {
+            size_t i = stack.back();
+            stack.pop_back();
+            int x = (int)(i % d.x);
+            int y = (int)((i / d.x) % d.y);
+            int z = (int)(i / ((size_t)d.x * d.y));
+            if (x > 0) pushOutside(x - 1, y, z);
+            if (x < d.x - 1) pushOutside(x + 1, y, z);
+            if (y > 0) pushOutside(x, y - 1, z);
+            if (y < d.y - 1) pushOutside(x, y + 1, z);
+            if (z > 0) pushOutside(x, y, z - 1);
+            if (z < d.z - 1) pushOutside(x, y, z + 1);
+        }
+
+        return grid;
+    }
+
+    float distanceToSegment(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b)
+    {
+        glm::vec3 ab = b - a;
+        float len2 = glm::dot(ab, ab);
+        if (len2 < 1e-12f)
+            return glm::length(p - a);
+        float t = glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f);
+        return glm::length(p - (a + t * ab));
+    }
+
+    // 骨骼（head -> tail 线段）经过的实体体素作为种子；
+    // 骨骼完全在网格外时取离线段最近的实体体素
+    std::vector<std::pair<uint32_t, float>> boneSeeds(
+        const VoxelGrid &grid,
+        const std::vector<uint32_t> &solidVoxels,
+        const Bone &bone)
+    {
+        glm::vec3 head = glm::vec3(bone.restMatrix[3]);
+        glm::vec3 tail = bone.tail;
+
+        std::vector<std::pair<uint32_t, float>> seeds;
+        int samples = std::max(1, (int)std::ceil(glm::length(tail - head) / (0.5f * grid.size)));
+        for (int s = 0; s <= samples; s++)
+        {
+            glm::vec3 p = glm::mix(head, tail, (float)s / samples);
+            glm::ivec3 c = grid.cellOf(p);
+            size_t i = grid.index(c.x, c.y, c.z);
+            if (grid.solid(i))
+                seeds.emplace_back((uint32_t)i, 0.0f);
+        }
+
+        if (seeds.empty())
+        {
+            uint32_t best = 0;
+            float bestDist = INF;
+            for (uint32_t i : solidVoxels)
+            {
+                float dist = distanceToSegment(grid.center(i), head, tail);
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = i;
+                }
+            }
+            if (bestDist < INF)
+                seeds.emplace_back(best, bestDist);
+        }
+        return seeds;
+    }
+
+    // 在实体体素上做 26 邻域 Dijkstra，得到到种子的测地距离
+    void propagate(
+        const VoxelGrid &grid,
+        const std::vector<std::pair<uint32_t, float>> &seeds,
+        std::vector<float> &dist)
+    {
+        struct Step
+        {
+            int dx, dy, dz;
+            float cost;
+        };
+        static const std::vector<Step> steps = []()
+        {
+            std::vector<Step> s;
+            for (int dz = -1; dz <= 1; dz++)
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        if (dx == 0 && dy == 0 && dz == 0)
+                            continue;
+                        s.push_back({dx, dy, dz, std::sqrt((float)(dx * dx + dy * dy + dz * dz))});
+                    }
+            return s;
+        }();
+
+        std::fill(dist.begin(), dist.end(), INF);
+
+        using Item = std::pair<float, uint32_t>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+        for (const auto &s : seeds)
+        {
+            if (s.second < dist[s.first])
+            {
+                dist[s.first] = s.second;
+                open.emplace(s.second, s.first);
+            }
+        }
+
+        const glm::ivec3 d = grid.dims;
+        while (!open.empty())
+        {
+            Item top = open.top();
+            open.pop();
+            uint32_t i = top.second;
+            if (top.first > dist[i])
+                continue;
+
+            int x = (int)(i % d.x);
+            int y = (int)((i / d.x) % d.y);
+            int z = (int)(i / ((size_t)d.x * d.y));
+            for (const Step &s : steps)
+            {
+                int nx = x + s.dx, ny = y + s.dy, nz = z + s.dz;
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= d.x || ny >= d.y || nz >= d.z)
+                    continue;
+                size_t j = grid.index(nx, ny, nz);
+                if (!grid.solid(j))
+                    continue;
+                float nd = top.first + s.cost * grid.size;
+                if (nd < dist[j])
+                {
+                    dist[j] = nd;
+                    open.emplace(nd, (uint32_t)j);
+                }
+            }
+        }
+    }
+
+    // 按距离升序维护最近的 4 根骨骼
+    void insertNearest(glm::ivec4 &ids, glm::vec4 &dists, int bone, float d)
+    {
+        if (!(d < dists[3]))
+            return;
+        int k = 3;
+        while (k > 0 && d < dists[k - 1])
+        {
+            dists[k] = dists[k - 1];
+            ids[k] = ids[k - 1];
+            k--;
+        }
+        dists[k] = d;
+        ids[k] = bone;
+    }
+}
+
+void VoxelSkinning::computeWeights(Mesh &mesh, const Skeleton &skeleton, int resolution)
+{
+    PROFILE_SCOPE("VoxelSkinning::computeWeights");
+    const int B = (int)skeleton.bones.size();
+    const size_t V = mesh.vertices.size();
+    if (B == 0 || V == 0)
+        return;
+
+    VoxelGrid grid = voxelize(mesh, std::max(resolution, 8));
+
+    std::vector<uint32_t> solidVoxels;
+    for (size_t i = 0; i < grid.count(); i++)
+        if (grid.solid(i))
+            solidVoxels.push_back((uint32_t)i);
+
+    std::vector<uint32_t> vertexVoxel(V);
+    for (size_t v = 0; v < V; v++)
+    {
+        glm::ivec3 c = grid.cellOf(mesh.vertices[v].position);
+        vertexVoxel[v] = (uint32_t)grid.index(c.x, c.y, c.z);
+    }
+
+    std::vector<glm::ivec4> nearestIDs(V, glm::ivec4(-1));
+    std::vector<glm::vec4> nearestDist(V, glm::vec4(INF));
+
+    // 按线程数分批处理骨骼：每根骨骼一张距离场，批内并行传播，
+    // 然后按顶点并行合并到每个顶点的最近 4 根骨骼，内存只与批大小相关
+    const size_t batch = parallelThreadCount();
+    std::vector<std::vector<float>> fields(std::min<size_t>(batch, B), std::vector<float>(grid.count()));
+
+    for (size_t first = 0; first < (size_t)B; first += batch)
+    {
+        size_t last = std::min((size_t)B, first + batch);
+
+        parallelFor(first, last, 1, [&](size_t b, size_t e)
+        {
+            for (size_t bone = b; bone < e; bone++)
+                propagate(grid, boneSeeds(grid, solidVoxels, skeleton.bones[bone]), fields[bone - first]);
+        });
+
+        parallelFor(0, V, 4096, [&](size_t b, size_t e)
+        {
+            for (size_t v = b; v < e; v++)
+                for (size_t bone = first; bone < last; bone++)
+                    insertNearest(nearestIDs[v], nearestDist[v], (int)bone, fields[bone - first][vertexVoxel[v]]);
+        });
+    }
+
+    // 距离转权重：w = 1 / ((1 - a) d + a d^2)^2，d 加上一个体素大小避免除零
+    const float alpha = 0.5f;
+    parallelFor(0, V, 4096, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            Vertex &v = mesh.vertices[i];
+            glm::ivec4 &ids = nearestIDs[i];
+            glm::vec4 &dists = nearestDist[i];
+
+            // 顶点所在的连通块里没有任何骨骼（例如漂浮的碎片），退化为欧氏距离
+            if (ids[0] < 0)
+            {
+                for (int bone = 0; bone < B; bone++)
+                {
+                    const Bone &bn = skeleton.bones[bone];
+                    insertNearest(ids, dists, bone, distanceToSegment(v.position, glm::vec3(bn.restMatrix[3]), bn.tail));
+                }
+            }
+
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                if (ids[k] < 0 || !(dists[k] < INF))
+                {
+                    v.boneIDs[k] = 0;
+                    v.weights[k] = 0.0f;
+                    continue;
+                }
+                float d = dists[k] + grid.size;
+                float w = 1.0f / ((1.0f - alpha) * d + alpha * d * d);
+                v.boneIDs[k] = ids[k];
+                v.weights[k] = w * w;
+                sum += v.weights[k];
+            }
+
+            if (sum > 0.0f)
+            {
+                for (int k = 0; k < 4; k++)
+                    v.weights[k] /= sum;
+            }
+            else
+            {
+                v.boneIDs = glm::ivec4(0);
+                v.weights = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+            }
+        }
+    });
+}
@@ -0,0 +1,98 @@
+#include "WeightSmoothing.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    struct Influences
+    {
+        glm::ivec4 ids = glm::ivec4(0);
+        glm::vec4 weights = glm::vec4(0.0f);
+    };
+
+    void accumulate(std::vector<std::pair<int, float>> &acc, const Influences &inf, float scale)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            if (inf.weights[k] <= 0.0f)
+                continue;
+            auto it = std::find_if(acc.begin(), acc.end(), [&](const std::pair<int, float> &e)
+                                   { return e.first == inf.ids[k]; });
+            if (it != acc.end())
+                it->second += inf.weights[k] * scale;
+            else
+                acc.emplace_back(inf.ids[k], inf.weights[k] * scale);
+        }
+    }
+}
+
+void WeightSmoothing::smooth(Mesh &mesh, int iterations, float lambda)
+{
+    PROFILE_SCOPE("WeightSmoothing::smooth");
+    if (iterations <= 0 || mesh.vertices.empty())
+        return;
+
+    MeshAdjacency adj = mesh.buildAdjacency();
+    const size_t nodes = adj.nodeCount();
+
+    // 双缓冲：front 为上一轮结果，back 为本轮输出
+    std::vector<Influences> front(nodes), back(nodes);
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+    {
+        Influences &inf = front[adj.vertexToNode[v]];
+        inf.ids = mesh.vertices[v].boneIDs;
+        inf.weights = mesh.vertices[v].weights;
+    }
+
+    for (int it = 0; it < iterations; it++)
+    {
+        parallelFor(0, nodes, 2048, [&](size_t b, size_t e)
+        {
+            std::vector<std::pair<int, float>> acc;
+            for (size_t i = b; i < e; i++)
+            {
+                const unsigned int first = adj.offsets[i];
+                const unsigned int last = adj.offsets[i + 1];
+                if (first == last)
+                {
+                    back[i] = front[i];
+                    continue;
+                }
+
+                acc.clear();
+                accumulate(acc, front[i], 1.0f - lambda);
+                const float share = lambda / (float)(last - first);
+                for (unsigned int n = first; n < last; n++)
+                    accumulate(acc, front[adj.neighbors[n]], share);
+
+                // 重新选取前 4 个影响并归一化
+                size_t keep = std::min<size_t>(4, acc.size());
+                std::partial_sort(acc.begin(), acc.begin() + keep, acc.end(),
+                                  [](const std::pair<int, float> &a, const std::pair<int, float> &c)
+                                  { return a.second > c.second; });
+
+                float sum = 0.0f;
+                for (size_t k = 0; k < keep; k++)
+                    sum += acc[k].second;
+
+                Influences out;
+                for (size_t k = 0; k < keep && sum > 0.0f; k++)
+                {
+                    out.ids[k] = acc[k].first;
+                    out.weights[k] = acc[k].second / sum;
+                }
+                back[i] = out;
+            }
+        });
+        std::swap(front, back);
+    }
+
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+    {
+        const Influences &inf = front[adj.vertexToNode[v]];
+        mesh.vertices[v].boneIDs = inf.ids;
+        mesh.vertices[v].weights = inf.weights;
+    }
+}
@@ -0,0 +1,133 @@
+#include "Y4MWriter.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
+#include "ColorConvert.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+    const char FRAME_HEADER[] = "FRAME\n";
+    const size_t FRAME_HEADER_SIZE = sizeof(FRAME_HEADER) - 1;
+}
+
+Y4MWriter::Y4MWriter(const std::string &p, int w, int h, int f)
+    : path(p), width(w), height(h), fps(f), file(nullptr), nextFrame(0), writeFailed(false)
+{
+    size_t lumaSize = (size_t)width * height;
+    size_t chromaSize = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    for (auto &data : frameData)
+    {
+        data.resize(FRAME_HEADER_SIZE + lumaSize + 2 * chromaSize);
+        std::memcpy(data.data(), FRAME_HEADER, FRAME_HEADER_SIZE);
+    }
+    MemoryStats::set(MemoryCategory::FrameBuffers, "Y4M frame ring", RING_SIZE * frameData[0].size());
+}
+
+Y4MWriter::~Y4MWriter()
+{
+    finish();
+    if (file && file != stdout)
+        fclose(file);
+    MemoryStats::set(MemoryCategory::FrameBuffers, "Y4M frame ring", 0);
+}
+
+bool Y4MWriter::open()
+{
+    if (toStdout())
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        file = stdout;
+    }
+    else
+    {
+        file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "Failed to open Y4M output: " << path << std::endl;
+            return false;
+        }
+    }
+
+    // C420jpeg：色度为 2x2 中心采样；Y4M 无法标注矩阵，编码时需要指定 bt709
+    if (fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps) < 0)
+    {
+        std::cerr << "Failed to write Y4M header: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Y4MWriter::writeFrame(int frame, const unsigned char *pixels)
+{
+    PROFILE_SCOPE("Y4M write frame");
+    if (!file || writeFailed)
+        return;
+    if (frame != nextFrame)
+        std::cerr << "Y4M frame " << frame << " arrived out of order (expected " << nextFrame << ")" << std::endl;
+    nextFrame = frame + 1;
+
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    const int slot = frame % RING_SIZE;
+    scheduler.wait(writes[slot]);
+    std::vector<unsigned char> &data = frameData[slot];
+
+    // 按偶数行对齐切成行带并行转换，每个行带对应完整的色度行
+    size_t lumaSize = (size_t)width * height;
+    size_t chromaWidth = (size_t)(width + 1) / 2;
+    size_t chromaSize = chromaWidth * ((height + 1) / 2);
+    unsigned char *y = data.data() + FRAME_HEADER_SIZE;
+    unsigned char *u = y + lumaSize, *v = u + chromaSize;
+    const size_t rowPairs = (size_t)(height + 1) / 2;
+    parallelFor(0, rowPairs, 32, [&](size_t b, size_t e)
+                {
+                    int row = (int)(2 * b), rows = std::min(height, (int)(2 * e)) - row;
+                    rgbaToYuv420(pixels + (size_t)row * width * 4, width, rows, y + (size_t)row * width,
+                                 u + b * chromaWidth, v + b * chromaWidth);
+                });
+
+    // 写任务依赖上一帧的写任务，按帧顺序追加；在 IO 线程上执行，与下一帧的行带转换重叠
+    writes[slot] = scheduler.submit([this, frame, &data]()
+                                    {
+                                        if (writeFailed)
+                                            return;
+                                        if (fwrite(data.data(), 1, data.size(), file) != data.size())
+                                        {
+                                            // 管道另一端退出时不再继续写
+                                            std::cerr << "Failed to write Y4M frame " << frame << std::endl;
+                                            writeFailed = true;
+                                        }
+                                    },
+                                    {lastWrite}, TaskKind::IO);
+    lastWrite = writes[slot];
+}
+
+void Y4MWriter::finish()
+{
+    if (lastWrite)
+        TaskScheduler::instance().wait(lastWrite);
+    if (!file)
+        return;
+    if (writeFailed)
+    {
+        if (file != stdout)
+            fclose(file);
+        file = nullptr;
+        return;
+    }
+    fflush(file);
+}
+
+const char *Y4MWriter::describe() const
+{
+    return toStdout() ? "-" : path.c_str();
+}
@@ -2,8 +2,24 @@
 #include "Mesh.h"
 #include "Shader.h"
 #include "HeatSkinning.h"
+#include "BonePalette.h"
+#include "RenderContext.h"
+#include "FrameReadback.h"
+#include "FrameWriter.h"
+#include "Y4MWriter.h"
+#include "UringWriter.h"
+#include "FrameShards.h"
+#include "CpuSkinning.h"
+#include "SoftwareRenderer.h"
+#include "SkinnedBounds.h"
+#include "TriangleBVH.h"
+#include "SelfCollision.h"
+#include "Profiler.h"
+#include "MemoryStats.h"
+#include "VoxelSkinning.h"
+#include "WeightSmoothing.h"
+#include "Parallel.h"
 #include "glad/glad.h"
-#include "GLFW/glfw3.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -14,6 +30,10 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <csignal>
 
 // 窗口大小
 const int WINDOW_WIDTH = 1920;
@@ -22,23 +42,159 @@ const float FPS = 30.0f;
 const float DURATION = 10.0f; // 10秒视频
 const int TOTAL_FRAMES = (int)(FPS * DURATION);
 
-GLFWwindow *window = nullptr;
-Shader shader;
+// 场景光照和背景色（GPU 和软件渲染共用）
+const glm::vec3 LIGHT_DIR(0.5f, -1.0f, 0.3f);
+const glm::vec3 LIGHT_COLOR(1.0f, 1.0f, 1.0f);
+const glm::vec3 CLEAR_COLOR(0.2f, 0.3f, 0.3f);
+
+// 命令行参数
+struct Options
+{
+    std::string binding = "heat"; // 权重求解方式：heat | voxel
+    int voxelResolution = 128;    // 体素绑定时包围盒最长边的体素数
+    int smoothIterations = 0;     // 权重拉普拉斯平滑迭代次数
+    int crowd = 1;                // 实例化绘制的角色数量
+    ContextBackend context = ContextBackend::GLFW; // OpenGL 上下文：glfw | egl（无窗口系统）
+    bool asyncReadback = true;    // 帧读回：pbo（异步 PBO 环）| sync（glFinish + glReadPixels）
+    int readbackRing = 3;         // PBO 环的大小
+    std::string format = "ppm";   // 输出格式：ppm | png（图像序列）| y4m（单个视频流）| raw（io_uring 原始帧容器）
+    bool directIO = false;        // raw 输出使用 O_DIRECT
+    std::string output = "output/animation.y4m"; // y4m 输出路径，"-" 表示标准输出
+    int writerThreads = 0;        // 同时编码的帧数，决定图像序列的缓冲池大小，0 表示按 CPU 核数
+    int shards = 1;               // 按帧区间分成几个进程并行渲染
+    bool benchSkinning = false;   // 只运行 CPU 蒙皮基准测试
+    bool selfCollision = false;   // 只运行自碰撞检测，不渲染
+    std::string renderer = "gl";  // 渲染后端：gl | software（CPU 分块光栅化，不需要 OpenGL）
+    bool culling = true;          // 按蒙皮包围盒做视锥剔除
+    int cullPartitions = 8;       // 按骨骼把网格切成几个子网格分别剔除，1 表示只剔除整个角色
+    std::string trace;            // 非空时记录各阶段耗时并导出为 Chrome trace JSON
+    bool schedulerStats = false;  // 渲染结束时打印任务调度器每个线程的任务数、偷取次数和空闲时间
+    std::string meshPath = "assets/skeleton.obj";      // 角色网格（可用 RigGen 生成更大规模的角色）
+    std::string skeletonPath = "assets/skeleton.json"; // 角色骨架
+};
+
+RenderContext context;
 Mesh mesh;
 Skeleton skeleton;
-unsigned int VAO, VBO, EBO;
+unsigned int VAO, VBO, EBO, instanceVBO;
+BonePalette bonePalette;
+FrameReadback readback;
+SoftwareRenderer softwareRenderer;
+CpuSkinning softwareSkinning;
+
+// 人群中的一个角色：所有角色共享同一个 VAO，逐实例的数据放在 instanceVBO 中
+struct CharacterInstance
+{
+    glm::mat4 model;
+    int paletteOffset; // 该角色的骨骼矩阵在本帧调色板区域中的起始序号
+};
+
+std::vector<CharacterInstance> instances;
+std::vector<float> instanceTimeOffsets; // 每个角色的行走动画时间偏移
+glm::vec3 cameraPos(0, 5, 15);
+glm::vec3 cameraTarget(0, 4, 0);
+float cameraFar = 100.0f;
+
+// 着色器 uniform 句柄，加载 shader 后解析一次
+struct SkinningUniforms
+{
+    int view, projection;
+    int bonePalette, paletteBase, nonUniformScale;
+    int lightDir, lightColor, viewPos;
+};
+
+// 按影响骨骼数特化的蒙皮着色器变体
+struct SkinningProgram
+{
+    int influences;
+    Shader shader;
+    SkinningUniforms uniforms;
+};
+
+SkinningProgram programs[3] = {{1, {}, {}}, {2, {}, {}}, {4, {}, {}}};
+std::vector<DrawRange> drawRanges;
+SkinnedBounds skinnedBounds;
+
+// 上一帧的剔除统计
+struct CullStats
+{
+    size_t visibleCharacters; // 包围盒与视锥相交的角色数
+    size_t drawnRanges;       // 实际绘制的（区间，角色）数
+    size_t totalRanges;       // 不剔除时需要绘制的（区间，角色）数
+};
+CullStats cullStats = {0, 0, 0};
+
+SkinningProgram *programFor(int influences)
+{
+    for (auto &p : programs)
+    {
+        if (p.influences == influences)
+            return &p;
+    }
+    return nullptr;
+}
+
+void resolveUniforms(SkinningProgram &program)
+{
+    const Shader &shader = program.shader;
+    SkinningUniforms &uniforms = program.uniforms;
+    uniforms.view = shader.uniform("uView");
+    uniforms.projection = shader.uniform("uProjection");
+    uniforms.bonePalette = shader.uniform("uBonePalette");
+    uniforms.paletteBase = shader.uniform("uPaletteBase");
+    uniforms.nonUniformScale = shader.uniform("uNonUniformScale");
+    uniforms.lightDir = shader.uniform("uLightDir");
+    uniforms.lightColor = shader.uniform("uLightColor");
+    uniforms.viewPos = shader.uniform("uViewPos");
+}
+
+// 行走动画驱动的腿部骨骼，加载骨架后按名称查找；缺少任何一个时为 -1
+struct LegBones
+{
+    int thighL = -1, shinL = -1, footL = -1;
+    int thighR = -1, shinR = -1, footR = -1;
+
+    bool found() const { return thighL >= 0 && shinL >= 0 && footL >= 0 && thighR >= 0 && shinR >= 0 && footR >= 0; }
+};
+LegBones legBones;
+
+LegBones findLegBones(const Skeleton &skeleton)
+{
+    LegBones legs;
+    legs.thighL = skeleton.findBone("thigh.L");
+    legs.shinL = skeleton.findBone("shin.L");
+    legs.footL = skeleton.findBone("foot.L");
+    legs.thighR = skeleton.findBone("thigh.R");
+    legs.shinR = skeleton.findBone("shin.R");
+    legs.footR = skeleton.findBone("foot.R");
+    return legs;
+}
 
 // 动画函数：简单的行走动画
 // 完全独立的腿部行走动画
 void updateWalkingAnimation(float time, Skeleton &skeleton)
 {
+    PROFILE_SCOPE("Animation");
+
     // 1. 重置所有骨骼到 rest pose
     for (auto &b : skeleton.bones)
         b.poseMatrix = b.restMatrix;
 
+    // 没有腿部骨骼的骨架（例如 RigGen 生成的角色）：每个骨骼按各自的相位摆动
+    if (!legBones.found())
+    {
+        for (size_t i = 0; i < skeleton.bones.size(); i++)
+        {
+            Bone &b = skeleton.bones[i];
+            if (b.parent >= 0)
+                b.poseMatrix = b.restMatrix * glm::rotate(glm::mat4(1.0f), 0.3f * std::sin(time * 3.0f + i * 0.5f), glm::vec3(1, 0, 0));
+        }
+        return;
+    }
+
     // 2. 下半身骨骼索引
-    int thighL = 149, shinL = 150, footL = 151;
-    int thighR = 154, shinR = 155, footR = 156;
+    const int thighL = legBones.thighL, shinL = legBones.shinL, footL = legBones.footL;
+    const int thighR = legBones.thighR, shinR = legBones.shinR, footR = legBones.footR;
 
     // 3. 行走相位
     float phase = std::sin(time * 3.0f);
@@ -61,69 +217,74 @@ void updateWalkingAnimation(float time, Skeleton &skeleton)
                                        glm::rotate(glm::mat4(1.0f), lift, glm::vec3(1, 0, 0));
 }
 
-// 保存帧到文件
-void saveFrame(const std::string &filename, int frameWidth, int frameHeight)
+// 同步保存帧：阻塞读回当前帧，读回缓冲在帧之间复用
+void saveFrame(FrameSink &sink, int frame, int frameWidth, int frameHeight)
 {
-    std::vector<unsigned char> pixels(frameWidth * frameHeight * 3);
-    glReadPixels(0, 0, frameWidth, frameHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
-
-    // 翻转Y轴（OpenGL的坐标系是上下颠倒的）
-    std::vector<unsigned char> flipped(frameWidth * frameHeight * 3);
-    for (int y = 0; y < frameHeight; y++)
-    {
-        for (int x = 0; x < frameWidth; x++)
-        {
-            int srcIndex = (y * frameWidth + x) * 3;
-            int dstIndex = ((frameHeight - 1 - y) * frameWidth + x) * 3;
-            flipped[dstIndex] = pixels[srcIndex];
-            flipped[dstIndex + 1] = pixels[srcIndex + 1];
-            flipped[dstIndex + 2] = pixels[srcIndex + 2];
-        }
-    }
-
-    // 保存为PPM格式（简单格式，可以用FFmpeg转换成视频）
-    std::ofstream file(filename, std::ios::binary);
-    file << "P6\n"
-         << frameWidth << " " << frameHeight << "\n255\n";
-    file.write((char *)flipped.data(), flipped.size());
-    file.close();
+    PROFILE_SCOPE("saveFrame");
+    static std::vector<unsigned char> pixels;
+    int channels = sink.channels();
+    pixels.resize((size_t)frameWidth * frameHeight * channels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, frameWidth, frameHeight, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    sink.writeFrame(frame, pixels.data());
 }
 
-bool initOpenGL()
+// 把 count 个角色排成方阵，每个角色的动画时间错开；只有一个角色时就是原来的单角色画面
+void setupCrowd(int count)
 {
-    // 初始化GLFW
-    if (!glfwInit())
+    const int side = (int)std::ceil(std::sqrt((float)count));
+    const float spacing = 2.0f;
+    const float walkPeriod = 2.0f * 3.14159265f / 3.0f; // 与 updateWalkingAnimation 中的 sin(time * 3) 一致
+
+    instances.resize(count);
+    instanceTimeOffsets.resize(count);
+    for (int i = 0; i < count; i++)
     {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return false;
+        int row = i / side, col = i % side;
+        glm::vec3 offset((col - (side - 1) * 0.5f) * spacing, 0.0f, -row * spacing);
+        instances[i].model = glm::translate(glm::mat4(1.0f), offset);
+        instances[i].paletteOffset = i * (int)skeleton.bones.size();
+        // 黄金分割序列，保证偏移确定且分布均匀
+        instanceTimeOffsets[i] = std::fmod(i * 0.6180339887f, 1.0f) * walkPeriod;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // 隐藏窗口，因为我们只是渲染视频
+    // 逐帧姿态：每个线程一份骨骼副本和局部调色板（见 render 和 renderSoftware）
+    MemoryStats::set(MemoryCategory::Animation, "Crowd instances",
+                     MemoryStats::bytes(instances) + MemoryStats::bytes(instanceTimeOffsets));
+    MemoryStats::set(MemoryCategory::Animation, "Pose scratch",
+                     parallelThreadCount() * skeleton.bones.size() * (sizeof(Bone) + sizeof(glm::mat4)));
 
-    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Skinning Animation", nullptr, nullptr);
-    if (!window)
+    if (count > 1)
     {
-        std::cerr << "Failed to create window" << std::endl;
-        glfwTerminate();
-        return false;
+        cameraPos = glm::vec3(0.0f, 5.0f + side * 0.5f, 15.0f + side * 1.5f);
+        cameraTarget = glm::vec3(0.0f, 2.0f, -(side - 1) * spacing * 0.5f);
+        cameraFar = 100.0f + side * spacing * 2.0f;
     }
+}
 
-    glfwMakeContextCurrent(window);
-
-    // 初始化GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+// 把逐实例属性指向实例缓冲中第 firstInstance 项开始的数据。
+// GL 3.3 没有 baseInstance，每个绘制区间用各自的一段实例时靠调整属性偏移实现；
+// 实例缓冲剔除时每帧重新分配，大小变化时才重新登记
+void trackInstanceBuffer(size_t bytes)
+{
+    static size_t recorded = 0;
+    if (bytes != recorded)
     {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        return false;
+        MemoryStats::set(GpuMemoryCategory::InstanceBuffer, "Instance VBO", bytes);
+        recorded = bytes;
     }
+}
 
-    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-    glEnable(GL_DEPTH_TEST);
-
-    return true;
+// 调用时需要绑定 VAO，且 instanceVBO 绑定在 GL_ARRAY_BUFFER 上
+void bindInstanceAttributes(size_t firstInstance)
+{
+    size_t base = firstInstance * sizeof(CharacterInstance);
+    for (int c = 0; c < 4; c++)
+    {
+        glVertexAttribPointer(4 + c, 4, GL_FLOAT, GL_FALSE, sizeof(CharacterInstance),
+                              (void *)(base + offsetof(CharacterInstance, model) + c * sizeof(glm::vec4)));
+    }
+    glVertexAttribIPointer(8, 1, GL_INT, sizeof(CharacterInstance), (void *)(base + offsetof(CharacterInstance, paletteOffset)));
 }
 
 void setupMesh()
@@ -139,6 +300,8 @@ void setupMesh()
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    MemoryStats::set(GpuMemoryCategory::VertexBuffer, "Mesh VBO", mesh.vertices.size() * sizeof(Vertex));
+    MemoryStats::set(GpuMemoryCategory::IndexBuffer, "Mesh EBO", mesh.indices.size() * sizeof(unsigned int));
 
     // 位置
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
@@ -156,135 +319,576 @@ void setupMesh()
     glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, weights));
     glEnableVertexAttribArray(3);
 
+    // 逐实例：模型矩阵按列占用 4-7，调色板偏移占用 8。
+    // 实例缓冲每帧按剔除结果重新填写（见 render）
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CharacterInstance), instances.data(), GL_STREAM_DRAW);
+    trackInstanceBuffer(instances.size() * sizeof(CharacterInstance));
+    bindInstanceAttributes(0);
+    for (int c = 0; c < 4; c++)
+    {
+        glEnableVertexAttribArray(4 + c);
+        glVertexAttribDivisor(4 + c, 1);
+    }
+    glEnableVertexAttribArray(8);
+    glVertexAttribDivisor(8, 1);
+
     glBindVertexArray(0);
 }
 
-// --- 计算骨骼矩阵供渲染使用 ---
-std::vector<glm::mat4> computeBoneMatrices(const Skeleton &skeleton)
+// 登记角色数据的内存占用：顶点的位置法线和骨骼权重分开统计
+void trackModelMemory()
 {
-    std::vector<glm::mat4> boneMatrices(skeleton.bones.size());
+    const size_t geometry = offsetof(Vertex, boneIDs);
+    MemoryStats::set(MemoryCategory::MeshVertices, "Mesh vertices", mesh.vertices.capacity() * geometry);
+    MemoryStats::set(MemoryCategory::Weights, "Bone IDs and weights", mesh.vertices.capacity() * (sizeof(Vertex) - geometry));
+    MemoryStats::set(MemoryCategory::MeshIndices, "Mesh indices", MemoryStats::bytes(mesh.indices));
 
-    for (size_t i = 0; i < skeleton.bones.size(); ++i)
+    size_t names = 0;
+    for (const Bone &bone : skeleton.bones)
+        names += bone.name.capacity() > 15 ? bone.name.capacity() + 1 : 0; // 短名称存放在 std::string 内部
+    MemoryStats::set(MemoryCategory::Skeleton, "Bones", MemoryStats::bytes(skeleton.bones) + names);
+    MemoryStats::set(MemoryCategory::Caches, "Draw ranges", MemoryStats::bytes(drawRanges));
+}
+
+// --- 渲染函数 ---
+void render(float time, bool culling)
+{
+    PROFILE_SCOPE("render");
+    glClearColor(CLEAR_COLOR.r, CLEAR_COLOR.g, CLEAR_COLOR.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // 变换矩阵
+    glm::mat4 view = glm::lookAt(cameraPos,
+                                 cameraTarget,
+                                 glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+                                            (float)WINDOW_WIDTH / WINDOW_HEIGHT,
+                                            0.1f, cameraFar);
+    // 在投影中上下翻转：FBO 里的图像直接是自上而下的行序，读回后无需 CPU 翻转
+    projection = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)) * projection;
+
+    // 每个角色按自己的时间偏移计算姿态，骨骼矩阵并行写入映射的调色板缓冲。
+    // 剔除时从 computeBoneMatrices 返回的线程局部结果（映射的内存只写不读）求出角色和各区间的包围盒
+    const size_t boneCount = skeleton.bones.size();
+    const size_t rangeCount = drawRanges.size();
+    static std::vector<BoundingBox> bounds; // 每个角色 1 + rangeCount 个：整个角色、各绘制区间
+    bounds.resize(culling ? instances.size() * (rangeCount + 1) : 0);
+    glm::mat4 *palette = bonePalette.map();
+    if (palette)
     {
-        int p = skeleton.bones[i].parent;
+        parallelFor(0, instances.size(), 16, [&](size_t b, size_t e)
+        {
+            PROFILE_SCOPE("Pose crowd");
+            thread_local Skeleton pose;
+            // 骨架只在第一次使用时拷贝；之后每个角色的姿态由 updateWalkingAnimation 从 restMatrix 重新设置
+            if (pose.bones.size() != boneCount)
+                pose.bones = skeleton.bones;
+            for (size_t i = b; i < e; i++)
+            {
+                updateWalkingAnimation(time + instanceTimeOffsets[i], pose);
+                const std::vector<glm::mat4> &matrices = pose.computeBoneMatrices(palette + i * boneCount);
+                if (!culling)
+                    continue;
+                BoundingBox *box = &bounds[i * (rangeCount + 1)];
+                skinnedBounds.compute(matrices.data(), instances[i].model, box[0], box + 1);
+            }
+        });
+        bonePalette.unmap();
+    }
+    bonePalette.bind(0);
 
-        if (p == -1)
+    // 每个绘制区间只画包围盒与视锥相交的角色：逐区间收集实例，拼接后写入动态实例缓冲
+    static std::vector<CharacterInstance> visible;
+    static std::vector<size_t> rangeFirst, rangeInstances;
+    static bool instanceBufferCulled = false; // instanceVBO 中是某一帧剔除后的实例，而不是完整的 instances
+    rangeFirst.assign(rangeCount, 0);
+    rangeInstances.assign(rangeCount, instances.size());
+    cullStats = {instances.size(), rangeCount * instances.size(), rangeCount * instances.size()};
+    if (culling && palette)
+    {
+        PROFILE_SCOPE("Culling");
+        Frustum frustum = Frustum::fromMatrix(projection * view);
+        visible.clear();
+        cullStats.visibleCharacters = 0;
+        for (size_t i = 0; i < instances.size(); i++)
         {
-            // 根骨骼
-            boneMatrices[i] = skeleton.bones[i].poseMatrix * skeleton.bones[i].invRestMatrix;
+            if (frustum.intersects(bounds[i * (rangeCount + 1)]))
+                cullStats.visibleCharacters++;
         }
-        else
+        for (size_t r = 0; r < rangeCount; r++)
+        {
+            rangeFirst[r] = visible.size();
+            for (size_t i = 0; i < instances.size(); i++)
+            {
+                if (frustum.intersects(bounds[i * (rangeCount + 1) + 1 + r]))
+                    visible.push_back(instances[i]);
+            }
+            rangeInstances[r] = visible.size() - rangeFirst[r];
+        }
+        cullStats.drawnRanges = visible.size();
+
+        // 整块重新分配再写入，驱动可以换一块新内存，不必等上一帧的绘制完成
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(1, visible.size()) * sizeof(CharacterInstance), nullptr, GL_STREAM_DRAW);
+        trackInstanceBuffer(std::max<size_t>(1, visible.size()) * sizeof(CharacterInstance));
+        glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(CharacterInstance), visible.data());
+        instanceBufferCulled = true;
+    }
+    else if (instanceBufferCulled)
+    {
+        // 本帧没有剔除（例如调色板映射失败），按完整的实例数绘制：实例缓冲必须恢复成完整列表
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CharacterInstance), instances.data(), GL_STREAM_DRAW);
+        trackInstanceBuffer(instances.size() * sizeof(CharacterInstance));
+        instanceBufferCulled = false;
+    }
+
+    // 只有出现非均匀缩放时着色器才走逐顶点求逆的法线路径
+    bool nonUniform = skeleton.hasNonUniformScale();
+    for (const auto &inst : instances)
+        nonUniform = nonUniform || !Skeleton::isUniformScale(inst.model);
+
+    for (auto &p : programs)
+        p.shader.resetStats();
+
+    // 每个区间用对应影响数的着色器变体绘制，该区间可见的所有角色一次实例化绘制
+    {
+        PROFILE_SCOPE("Draw");
+        GPU_PROFILE_SCOPE("Draw");
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (size_t r = 0; r < rangeCount; r++)
         {
-            // 所有骨骼都累乘父骨骼
-            boneMatrices[i] = boneMatrices[p] * skeleton.bones[i].poseMatrix * skeleton.bones[i].invRestMatrix;
+            const DrawRange &range = drawRanges[r];
+            if (rangeInstances[r] == 0)
+                continue;
+
+            SkinningProgram *program = programFor(range.influences);
+            Shader &shader = program->shader;
+            const SkinningUniforms &uniforms = program->uniforms;
+
+            shader.use();
+            shader.setMat4(uniforms.view, view);
+            shader.setMat4(uniforms.projection, projection);
+            shader.setInt(uniforms.bonePalette, 0);
+            shader.setInt(uniforms.paletteBase, bonePalette.base());
+            shader.setInt(uniforms.nonUniformScale, nonUniform ? 1 : 0);
+
+            // 光照
+            shader.setVec3(uniforms.lightDir, LIGHT_DIR);
+            shader.setVec3(uniforms.lightColor, LIGHT_COLOR);
+            shader.setVec3(uniforms.viewPos, cameraPos);
+
+            bindInstanceAttributes(rangeFirst[r]);
+            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(range.count), GL_UNSIGNED_INT,
+                                    (void *)(range.first * sizeof(unsigned int)),
+                                    static_cast<GLsizei>(rangeInstances[r]));
         }
+        bindInstanceAttributes(0);
+        glBindVertexArray(0);
     }
 
-    return boneMatrices;
+    bonePalette.fence();
+
+    context.swapBuffers();
 }
 
-// --- 渲染函数 ---
-void render()
+// 软件渲染一帧：每个角色在 CPU 上蒙皮后提交给分块光栅化器，结果在 softwareRenderer.pixels() 中
+void renderSoftware(float time, bool culling)
 {
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    PROFILE_SCOPE("renderSoftware");
+    glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, cameraFar);
+    softwareRenderer.beginFrame(view, projection, cameraPos, LIGHT_DIR, LIGHT_COLOR, CLEAR_COLOR);
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+    cullStats = {0, 0, instances.size()};
 
-    shader.use();
+    static std::vector<glm::mat4> palette;
+    static Skeleton pose;
+    static SkinnedVertices skinned;
+    palette.resize(skeleton.bones.size());
+    if (pose.bones.size() != skeleton.bones.size())
+        pose.bones = skeleton.bones;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        updateWalkingAnimation(time + instanceTimeOffsets[i], pose);
+        pose.computeBoneMatrices(palette.data());
 
-    // 变换矩阵
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 view = glm::lookAt(glm::vec3(0, 5, 15),
-                                 glm::vec3(0, 4, 0),
-                                 glm::vec3(0, 1, 0));
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
-                                            (float)WINDOW_WIDTH / WINDOW_HEIGHT,
-                                            0.1f, 100.0f);
+        // 整个角色在视锥外时连蒙皮一起跳过（软件渲染按角色剔除，不切分子网格）
+        if (culling)
+        {
+            BoundingBox box;
+            skinnedBounds.compute(palette.data(), instances[i].model, box, nullptr);
+            if (!frustum.intersects(box))
+                continue;
+        }
+        cullStats.visibleCharacters++;
+        cullStats.drawnRanges++;
+
+        softwareSkinning.skin(palette.data(), palette.size(), CpuSkinning::Mode::Linear, skinned);
+        softwareRenderer.drawMesh(skinned, mesh.indices, instances[i].model);
+    }
+
+    softwareRenderer.endFrame();
+}
 
-    shader.setMat4("uModel", model);
-    shader.setMat4("uView", view);
-    shader.setMat4("uProjection", projection);
+// 所有着色器变体本帧省掉的 GL 调用数
+int shaderCallsSaved()
+{
+    int saved = 0;
+    for (const auto &p : programs)
+        saved += p.shader.callsSaved();
+    return saved;
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--binding" && i + 1 < argc)
+            options.binding = argv[++i];
+        else if (arg == "--voxel-res" && i + 1 < argc)
+            options.voxelResolution = std::max(8, std::atoi(argv[++i]));
+        else if (arg == "--smooth" && i + 1 < argc)
+            options.smoothIterations = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--crowd" && i + 1 < argc)
+            options.crowd = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--readback" && i + 1 < argc)
+            options.asyncReadback = std::string(argv[++i]) != "sync";
+        else if (arg == "--readback-ring" && i + 1 < argc)
+            options.readbackRing = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--format" && i + 1 < argc)
+            options.format = argv[++i];
+        else if (arg == "--output" && i + 1 < argc)
+            options.output = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc)
+            options.shards = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--renderer" && i + 1 < argc)
+            options.renderer = argv[++i];
+        else if (arg == "--bench-skinning")
+            options.benchSkinning = true;
+        else if (arg == "--self-collision")
+            options.selfCollision = true;
+        else if (arg == "--mesh" && i + 1 < argc)
+            options.meshPath = argv[++i];
+        else if (arg == "--skeleton" && i + 1 < argc)
+            options.skeletonPath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            options.trace = argv[++i];
+        else if (arg == "--scheduler-stats")
+            options.schedulerStats = true;
+        else if (arg == "--no-cull")
+            options.culling = false;
+        else if (arg == "--cull-partitions" && i + 1 < argc)
+            options.cullPartitions = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--direct-io")
+            options.directIO = true;
+        else if (arg == "--writer-threads" && i + 1 < argc)
+            options.writerThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--context" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            options.context = (value == "egl") ? ContextBackend::EGL : ContextBackend::GLFW;
+        }
+        else
+            std::cerr << "Unknown argument: " << arg << std::endl;
+    }
+    return options;
+}
 
-    // 计算骨骼矩阵
-    std::vector<glm::mat4> boneMatrices = computeBoneMatrices(skeleton);
+// CPU 蒙皮基准测试：LBS / DQS 分别用标量和 AVX2 内核变形整条动画，报告每秒顶点数并校验两种内核一致
+int benchSkinning()
+{
+    const int iterations = 60;
+    CpuSkinning skinning;
+    skinning.prepare(mesh);
 
-    shader.setMat4Array("uBoneMatrices", boneMatrices);
+    std::vector<glm::mat4> palette(skeleton.bones.size());
+    Skeleton pose = skeleton;
+    SkinnedVertices reference, result;
 
-    // 光照
-    shader.setVec3("uLightDir", glm::vec3(0.5f, -1.0f, 0.3f));
-    shader.setVec3("uLightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-    shader.setVec3("uViewPos", glm::vec3(0, 5, 15));
+    std::cout << "CPU skinning benchmark: " << skinning.vertexCount() << " vertices, " << skeleton.bones.size()
+              << " bones, " << parallelThreadCount() << " threads, AVX2 "
+              << (CpuSkinning::hasAVX2() ? "available" : "not available") << std::endl;
 
-    // 绘制网格
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    const CpuSkinning::Mode modes[] = {CpuSkinning::Mode::Linear, CpuSkinning::Mode::DualQuaternion};
+    for (CpuSkinning::Mode mode : modes)
+    {
+        const char *modeName = mode == CpuSkinning::Mode::Linear ? "LBS" : "DQS";
+        for (int simd = 0; simd < 2; simd++)
+        {
+            if (simd && !CpuSkinning::hasAVX2())
+                continue;
+            skinning.setUseAVX2(simd != 0);
+
+            double seconds = 0.0;
+            float maxError = 0.0f;
+            for (int it = 0; it < iterations; it++)
+            {
+                updateWalkingAnimation((float)it / FPS, pose);
+                pose.computeBoneMatrices(palette.data());
+
+                auto start = std::chrono::steady_clock::now();
+                skinning.skin(palette.data(), palette.size(), mode, result);
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    glfwSwapBuffers(window);
+                // AVX2 结果与同一帧的标量结果比较
+                if (simd)
+                {
+                    skinning.setUseAVX2(false);
+                    skinning.skin(palette.data(), palette.size(), mode, reference);
+                    skinning.setUseAVX2(true);
+                    for (size_t i = 0; i < result.count; i++)
+                        maxError = std::max(maxError, glm::length(result.position(i) - reference.position(i)));
+                }
+            }
+
+            std::cout << "  " << modeName << (simd ? " AVX2  " : " scalar") << ": "
+                      << std::fixed << std::setprecision(1)
+                      << skinning.vertexCount() * iterations / seconds / 1e6 << " M vertices/s ("
+                      << std::setprecision(3) << seconds * 1000.0 / iterations << " ms/frame)";
+            if (simd)
+                std::cout << ", max difference to scalar " << std::scientific << std::setprecision(2) << maxError;
+            std::cout << std::defaultfloat << std::endl;
+        }
+    }
+    return 0;
 }
 
-int main()
+// 自碰撞检测：逐帧 CPU 蒙皮整条行走动画，把三角形 BVH refit 到当前姿态后检测不同部位之间的穿插。
+// 有穿插的帧各打印一行汇总，所有相交的三角形对写入 output/self_collision.csv
+int checkSelfCollision()
 {
-    // 1. 读取网格
-    std::cout << "Loading mesh..." << std::endl;
-    if (!mesh.loadOBJ("assets/skeleton.obj"))
+    CpuSkinning skinning;
+    skinning.prepare(mesh);
+    TriangleBVH bvh;
+    bvh.build(mesh);
+    SelfCollision collision;
+    collision.prepare(mesh, skeleton);
+    std::cout << "Self collision check: " << bvh.triangleCount() << " triangles, " << collision.candidatePairCount()
+              << " bone pairs (parent/child and shared-influence pairs skipped)" << std::endl;
+
+    const std::string csvPath = "output/self_collision.csv";
+    std::ofstream csv(csvPath);
+    if (!csv)
     {
-        std::cerr << "Failed to load mesh file" << std::endl;
+        std::cerr << "Failed to open " << csvPath << std::endl;
         return -1;
     }
+    csv << "frame,triangle_a,triangle_b,bone_a,bone_b,depth\n";
 
-    // 2. 读取骨架
-    std::cout << "Loading skeleton..." << std::endl;
-    if (!skeleton.loadFromJSON("assets/skeleton.json"))
+    std::vector<glm::mat4> palette(skeleton.bones.size());
+    Skeleton pose = skeleton;
+    SkinnedVertices skinned;
+    SelfCollisionReport report;
+
+    int collidingFrames = 0, deepestFrame = -1;
+    size_t totalPairs = 0, totalTests = 0;
+    float deepest = 0.0f;
+    double seconds = 0.0;
+    for (int frame = 0; frame < TOTAL_FRAMES; frame++)
     {
-        std::cerr << "Failed to load skeleton file" << std::endl;
-        return -1;
+        Profiler::setFrame(frame);
+        updateWalkingAnimation((float)frame / FPS, pose);
+        pose.computeBoneMatrices(palette.data());
+
+        auto start = std::chrono::steady_clock::now();
+        skinning.skin(palette.data(), palette.size(), CpuSkinning::Mode::Linear, skinned);
+        bvh.refit(skinned);
+        collision.detect(bvh, skinned, palette.data(), report);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        totalTests += report.triangleTests;
+        if (report.pairs.empty())
+            continue;
+
+        const TrianglePair *worst = &report.pairs[0];
+        for (const TrianglePair &pair : report.pairs)
+        {
+            if (pair.depth > worst->depth)
+                worst = &pair;
+            csv << frame << "," << pair.first << "," << pair.second << "," << skeleton.bones[pair.firstBone].name << ","
+                << skeleton.bones[pair.secondBone].name << "," << pair.depth << "\n";
+        }
+        std::cout << "  frame " << frame << ": " << report.pairs.size() << " triangle pairs, max depth "
+                  << report.maxDepth << " (" << skeleton.bones[worst->firstBone].name << " / "
+                  << skeleton.bones[worst->secondBone].name << ")" << std::endl;
+
+        collidingFrames++;
+        totalPairs += report.pairs.size();
+        if (report.maxDepth > deepest)
+        {
+            deepest = report.maxDepth;
+            deepestFrame = frame;
+        }
     }
 
-    for (size_t i = 0; i < skeleton.bones.size(); i++)
+    std::cout << collidingFrames << " / " << TOTAL_FRAMES << " frames self-intersect, " << totalPairs
+              << " triangle pairs in total";
+    if (deepestFrame >= 0)
+        std::cout << ", deepest " << deepest << " at frame " << deepestFrame;
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(3) << seconds * 1000.0 / TOTAL_FRAMES
+              << " ms/frame (skinning + BVH refit + detection), " << totalTests / TOTAL_FRAMES
+              << " triangle tests/frame, " << bvh.rebuildCount() << " BVH rebuilds" << std::defaultfloat << std::endl;
+    std::cout << "Triangle pairs written to " << csvPath << std::endl;
+    return 0;
+}
+
+// 按输出格式创建帧输出。create 为 false 时打开分片父进程已经创建好的输出（原始帧容器）
+std::unique_ptr<FrameSink> createSink(Options &options, bool create)
+{
+    std::unique_ptr<FrameSink> sink;
+    if (options.format == "y4m")
     {
-        std::cout << i << " : " << skeleton.bones[i].name << std::endl;
+        // 单个视频流：帧按顺序转成 YUV 追加写出，不产生中间图像文件
+        Y4MWriter *writer = new Y4MWriter(options.output, WINDOW_WIDTH, WINDOW_HEIGHT, (int)FPS);
+        sink.reset(writer);
+        if (!writer->open())
+            return nullptr;
+    }
+    else if (options.format == "raw")
+    {
+        // 原始帧写入预分配的单个容器文件，写请求异步提交，缓冲在写完成后回到池中
+        UringWriter *writer = new UringWriter("output/frames.raw", WINDOW_WIDTH, WINDOW_HEIGHT, TOTAL_FRAMES,
+                                              options.readbackRing + 2, options.directIO);
+        sink.reset(writer);
+        if (!writer->open(create))
+        {
+            if (!create)
+                return nullptr;
+            std::cerr << "Falling back to PPM output" << std::endl;
+            options.format = "ppm";
+            sink.reset();
+        }
+    }
+    if (!sink)
+    {
+        // 帧编码作为任务在调度器的工作线程上完成，缓冲池为编码并发数的两倍
+        int writerThreads = options.writerThreads > 0 ? options.writerThreads : (int)parallelThreadCount();
+        FrameWriter::Format format = options.format == "png" ? FrameWriter::Format::PNG : FrameWriter::Format::PPM;
+        sink.reset(new FrameWriter("output", format, WINDOW_WIDTH, WINDOW_HEIGHT, writerThreads * 2));
     }
+    return sink;
+}
 
-    // 3. 计算热传导权重
-    std::cout << "Computing heat diffusion weithts..." << std::endl;
-    HeatSkinning::computeWeights(mesh, skeleton);
-    // for (int v = 0; v < 100; v++)
-    // {
-    //     std::cout << "Vertex " << v << " weights: ";
-    //     for (int b = 0; b < 4; b++)
-    //         std::cout << mesh.vertices[v].weights[b] << "(" << mesh.vertices[v].boneIDs[b] << ") ";
-    //     std::cout << std::endl;
-    // }
+// 打印输出位置和转换成视频的命令
+void printOutputHint(const Options &options, const FrameSink &sink)
+{
+    if (options.format == "y4m")
+    {
+        bool streamToStdout = options.output == "-";
+        std::cout << "Rendering completed! Video stream written to " << (streamToStdout ? "stdout" : options.output) << std::endl;
+        if (!streamToStdout)
+        {
+            std::cout << "Use the following command to encode the stream:" << std::endl;
+            std::cout << "ffmpeg -i " << sink.describe() << " -colorspace bt709 -color_primaries bt709 -color_trc bt709"
+                      << " -c:v libx264 output/animation.mp4" << std::endl;
+        }
+    }
+    else if (options.format == "raw")
+    {
+        const UringWriter &writer = static_cast<const UringWriter &>(sink);
+        std::cout << "Rendering completed! Raw frames saved to " << writer.describe() << std::endl;
+        std::cout << "Use the following command to convert frames to video:" << std::endl;
+        if (writer.frameStride() == (size_t)WINDOW_WIDTH * WINDOW_HEIGHT * 3)
+            std::cout << "ffmpeg -f rawvideo -pix_fmt rgb24 -s " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT
+                      << " -r 30 -skip_initial_bytes " << UringWriter::HEADER_SIZE << " -i " << writer.describe()
+                      << " -c:v libx264 -pix_fmt yuv420p output/animation.mp4" << std::endl;
+        else
+            std::cout << "(frames are padded to " << writer.frameStride() << " bytes for O_DIRECT; "
+                      << "strip the padding before feeding ffmpeg -f rawvideo)" << std::endl;
+    }
+    else
+    {
+        std::cout << "Rendering completed! Frames saved to output/ directory" << std::endl;
+        std::cout << "Use the following command to convert frames to video:" << std::endl;
+        std::cout << "ffmpeg -r 30 -i " << sink.describe() << " -c:v libx264 -pix_fmt yuv420p output/animation.mp4" << std::endl;
+    }
+}
 
-    // 4. 初始化OpenGL
-    std::cout << "Initializing OpenGL..." << std::endl;
-    if (!initOpenGL())
+// 创建 OpenGL 上下文并渲染 [range.begin, range.end) 的帧。
+// 单进程时渲染整条时间线；分片模式下每个子进程各渲染自己的区间，createOutput 为 false
+int renderFrames(Options &options, const FrameRange &range, bool createOutput)
+{
+    const bool software = options.renderer == "software";
+    if (!software)
     {
-        return -1;
+        // 4. 初始化OpenGL
+        std::cout << "Initializing OpenGL..." << std::endl;
+        if (!context.create(options.context, WINDOW_WIDTH, WINDOW_HEIGHT))
+        {
+            return -1;
+        }
+
+        // 加载各影响数的着色器变体
+        for (auto &p : programs)
+        {
+            std::string defines = "#define MAX_INFLUENCES " + std::to_string(p.influences) + "\n";
+            if (!p.shader.loadFromFiles("shaders/skinning.vert", "shaders/skinning.frag", defines))
+            {
+                std::cerr << "Failed to load shader" << std::endl;
+                return -1;
+            }
+            resolveUniforms(p);
+        }
+
+        if (Profiler::enabled())
+            GpuProfiler::create();
     }
 
-    // 加载shader
-    if (!shader.loadFromFiles("shaders/skinning.vert", "shaders/skinning.frag"))
+    setupCrowd(options.crowd);
+    if (!software)
     {
-        std::cerr << "Failed to load shader" << std::endl;
+        setupMesh();
+
+        if (!bonePalette.create(skeleton.bones.size() * instances.size()))
+        {
+            return -1;
+        }
+    }
+
+    std::unique_ptr<FrameSink> sink = createSink(options, createOutput);
+    if (!sink)
         return -1;
+
+    if (software)
+    {
+        // 软件渲染直接写输出格式需要的通道数，帧缓冲交给 sink 即可
+        std::cout << "Using software renderer (" << parallelThreadCount() << " threads, CPU skinning "
+                  << (CpuSkinning::hasAVX2() ? "AVX2" : "scalar") << ")" << std::endl;
+        softwareRenderer.create(WINDOW_WIDTH, WINDOW_HEIGHT, sink->channels());
+        softwareSkinning.prepare(mesh);
     }
+    else if (options.asyncReadback)
+        readback.create(WINDOW_WIDTH, WINDOW_HEIGHT, options.readbackRing, sink->channels());
+    auto onFrameReady = [&sink](int frame, const unsigned char *pixels)
+    {
+        sink->writeFrame(frame, pixels);
+    };
 
-    setupMesh();
+    // 按角色数规划节点时用：角色数据所有实例共享，每多一个角色只增加实例数据，
+    // GPU 渲染时还有调色板中的 REGIONS 份骨骼矩阵（软件渲染的姿态和调色板在角色间复用）
+    MemoryStats::printReport(std::cout);
+    const size_t characterCpu = sizeof(CharacterInstance) + sizeof(float);
+    const size_t characterGpu = software ? 0 : skeleton.bones.size() * sizeof(glm::mat4) * BonePalette::REGIONS + sizeof(CharacterInstance);
+    std::cout << "  Per additional character: " << MemoryStats::format(characterCpu) << " CPU, "
+              << MemoryStats::format(characterGpu) << " GPU" << std::endl;
 
     // 5. 渲染视频帧
-    std::cout << "Start render " << TOTAL_FRAMES << " frame..." << std::endl;
+    const int frameCount = range.end - range.begin;
+    std::cout << "Start render " << frameCount << " frame (" << range.begin << " - " << range.end - 1 << ")..." << std::endl;
 
-// 创建output目录
-#ifdef _WIN32
-    system("if not exist output mkdir output");
-#else
-    system("mkdir -p output");
-#endif
-
-    for (int frame = 0; frame < TOTAL_FRAMES; frame++)
+    auto renderStart = std::chrono::steady_clock::now();
+    for (int frame = range.begin; frame < range.end; frame++)
     {
         float time = (float)frame / FPS;
+        Profiler::setFrame(frame);
+        PROFILE_SCOPE("Frame");
 
         // 更新动画
         updateWalkingAnimation(time, skeleton);
@@ -307,27 +911,255 @@ int main()
             }
         }
 
+        if (software)
+        {
+            // 软件渲染：帧缓冲直接交给输出
+            renderSoftware(time, options.culling);
+            sink->writeFrame(frame, softwareRenderer.pixels());
+
+            if ((frame + 1 - range.begin) % 30 == 0)
+            {
+                std::cout << (frame + 1 - range.begin) << " /" << frameCount << " frames has been rendered. ("
+                          << softwareRenderer.triangleCount() << " triangles, " << cullStats.visibleCharacters << "/"
+                          << instances.size() << " characters visible last frame)" << std::endl;
+            }
+            continue;
+        }
+
         // 渲染
-        render();
-        glFinish();
+        render(time, options.culling);
+
+        // 保存帧：异步模式下这一帧在之后几帧渲染期间读回
+        if (options.asyncReadback)
+        {
+            PROFILE_SCOPE("Readback");
+            GPU_PROFILE_SCOPE("Readback");
+            readback.readFrame(frame, onFrameReady);
+        }
+        else
+        {
+            glFinish();
+            saveFrame(*sink, frame, WINDOW_WIDTH, WINDOW_HEIGHT);
+        }
+
+        if ((frame + 1 - range.begin) % 30 == 0)
+        {
+            std::cout << (frame + 1 - range.begin) << " /" << frameCount << " frames has been rendered. ("
+                      << shaderCallsSaved() << " GL calls saved, " << cullStats.visibleCharacters << "/" << instances.size()
+                      << " characters visible, " << cullStats.drawnRanges << "/" << cullStats.totalRanges
+                      << " submesh draws last frame)" << std::endl;
+        }
+
+        // 取回已经完成的 GPU 计时，不等待
+        GpuProfiler::collect(false);
+
+        context.pollEvents();
+    }
+    Profiler::setFrame(-1);
+
+    if (!software && options.asyncReadback)
+        readback.flush(onFrameReady);
+    sink->finish();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+    std::cout << "Rendered " << frameCount << " frames in " << seconds << " s ("
+              << frameCount / seconds << " fps, "
+              << (software ? "software renderer" : options.asyncReadback ? "PBO readback" : "sync readback") << ")" << std::endl;
+    MemoryStats::printPeak(std::cout);
+    if (options.schedulerStats)
+        TaskScheduler::instance().printStats(std::cout);
+
+    if (createOutput)
+        printOutputHint(options, *sink);
+
+    sink.reset();
+    if (!software)
+    {
+        GpuProfiler::destroy();
+        readback.destroy();
+        bonePalette.destroy();
+        context.destroy();
+    }
+    return 0;
+}
+
+// 导出性能记录。分片时每个进程写自己的文件：trace.json -> trace.shard0.json
+void writeTrace(const Options &options, int shard)
+{
+    if (options.trace.empty())
+        return;
+    std::string path = options.trace;
+    if (shard >= 0)
+    {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = path.size();
+        path.insert(dot, ".shard" + std::to_string(shard));
+    }
+    if (Profiler::writeChromeTrace(path))
+        std::cout << "Trace written to " << path << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    Options options = parseOptions(argc, argv);
+    if (!options.trace.empty())
+        Profiler::setEnabled(true);
+    bool streamToStdout = options.format == "y4m" && options.output == "-";
+    if (streamToStdout)
+    {
+        // 标准输出留给视频流，日志全部改走标准错误
+        std::cout.rdbuf(std::cerr.rdbuf());
+#ifndef _WIN32
+        // 编码器提前退出时 fwrite 返回错误，而不是让 SIGPIPE 直接结束进程
+        signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+
+    // 1. 读取网格
+    std::cout << "Loading mesh..." << std::endl;
+    if (!mesh.loadOBJ(options.meshPath))
+    {
+        std::cerr << "Failed to load mesh file" << std::endl;
+        return -1;
+    }
+
+    // 2. 读取骨架
+    std::cout << "Loading skeleton..." << std::endl;
+    if (!skeleton.loadFromJSON(options.skeletonPath))
+    {
+        std::cerr << "Failed to load skeleton file" << std::endl;
+        return -1;
+    }
+
+    for (size_t i = 0; i < skeleton.bones.size(); i++)
+    {
+        std::cout << i << " : " << skeleton.bones[i].name << std::endl;
+    }
+    legBones = findLegBones(skeleton);
+
+    // 3. 计算蒙皮权重。热扩散绑定按原角色的骨骼序号挑选躯干和腿部，其他骨架只能用体素绑定
+    if (options.binding != "voxel" && !HeatSkinning::supports(skeleton))
+    {
+        std::cerr << "Heat binding needs the original character's skeleton, using voxel binding" << std::endl;
+        options.binding = "voxel";
+    }
+    if (options.binding == "voxel")
+    {
+        std::cout << "Computing voxel geodesic weights (resolution " << options.voxelResolution << ")..." << std::endl;
+        VoxelSkinning::computeWeights(mesh, skeleton, options.voxelResolution);
+    }
+    else
+    {
+        std::cout << "Computing heat diffusion weithts..." << std::endl;
+        HeatSkinning::computeWeights(mesh, skeleton);
+    }
 
-        // 保存帧
-        std::ostringstream filename;
-        filename << "output/frame_" << std::setfill('0') << std::setw(5) << frame << ".ppm";
-        saveFrame(filename.str(), WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (options.smoothIterations > 0)
+    {
+        std::cout << "Smoothing weights (" << options.smoothIterations << " iterations)..." << std::endl;
+        WeightSmoothing::smooth(mesh, options.smoothIterations);
+    }
+    // for (int v = 0; v < 100; v++)
+    // {
+    //     std::cout << "Vertex " << v << " weights: ";
+    //     for (int b = 0; b < 4; b++)
+    //         std::cout << mesh.vertices[v].weights[b] << "(" << mesh.vertices[v].boneIDs[b] << ") ";
+    //     std::cout << std::endl;
+    // }
 
-        if ((frame + 1) % 30 == 0)
+    // 按影响数把三角形分组，每组用最便宜的变体绘制；剔除时每组再按骨骼分组切成子网格
+    std::vector<int> bonePartition;
+    if (options.culling)
+        bonePartition = SkinnedBounds::partitionBones(skeleton, mesh, options.cullPartitions);
+    drawRanges = mesh.sortByInfluenceCount(bonePartition);
+    skinnedBounds.build(mesh, skeleton.bones.size(), drawRanges);
+    trackModelMemory();
+    for (int influences : {1, 2, 4})
+    {
+        size_t triangles = 0, submeshes = 0;
+        for (const DrawRange &range : drawRanges)
         {
-            std::cout << (frame + 1) << " /" << TOTAL_FRAMES << " frames has been rendered." << std::endl;
+            if (range.influences == influences)
+            {
+                triangles += range.count / 3;
+                submeshes++;
+            }
         }
+        if (triangles > 0)
+            std::cout << "  " << triangles << " triangles with up to " << influences << " influences ("
+                      << submeshes << " submeshes)" << std::endl;
+    }
+
+    if (options.benchSkinning)
+        return benchSkinning();
 
-        glfwPollEvents();
+// 创建output目录
+#ifdef _WIN32
+    system("if not exist output mkdir output");
+#else
+    system("mkdir -p output");
+#endif
+
+    if (options.selfCollision)
+    {
+        int result = checkSelfCollision();
+        writeTrace(options, -1);
+        return result;
+    }
+
+    if (options.shards > 1 && options.format == "y4m")
+    {
+        // Y4M 是单个顺序流，无法由多个进程分段写
+        std::cerr << "--shards is not supported with y4m output, rendering in one process" << std::endl;
+        options.shards = 1;
+    }
+    if (options.shards > 1 && !FrameShards::isSupported())
+        options.shards = 1;
+
+    if (options.shards <= 1)
+    {
+        int result = renderFrames(options, {0, TOTAL_FRAMES}, true);
+        writeTrace(options, -1);
+        return result;
+    }
+
+    // 按帧区间分片：在创建任何上下文之前 fork，每个子进程拥有自己的 headless 上下文
+    if (options.context == ContextBackend::GLFW && RenderContext::hasEGL())
+        options.context = ContextBackend::EGL;
+
+    // 原始帧容器由父进程创建、预分配并写好头部，各分片只写自己的帧。
+    // fork 前关闭它，子进程不继承父进程的 io_uring
+    if (options.format == "raw")
+    {
+        std::unique_ptr<FrameSink> container = createSink(options, true);
+        container->finish();
     }
 
-    std::cout << "Rendering completed! Frames saved to output/ directory" << std::endl;
-    std::cout << "Use the following command to convert frames to video:" << std::endl;
-    std::cout << "ffmpeg -r 30 -i output/frame_%05d.ppm -c:v libx264 -pix_fmt yuv420p output/animation.mp4" << std::endl;
+    std::vector<FrameRange> ranges = FrameShards::split(TOTAL_FRAMES, options.shards);
+    unsigned int threadsPerShard = std::max(1u, parallelThreadCount() / (unsigned int)ranges.size());
+    std::cout << "Rendering " << TOTAL_FRAMES << " frames in " << ranges.size() << " shard processes..." << std::endl;
+
+    auto renderStart = std::chrono::steady_clock::now();
+    int failures = FrameShards::run(ranges, [&options, threadsPerShard](int shard, const FrameRange &range)
+                                    {
+                                        setParallelThreadCount(threadsPerShard);
+                                        int result = renderFrames(options, range, false);
+                                        writeTrace(options, shard);
+                                        return result;
+                                    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+    if (failures > 0)
+    {
+        std::cerr << failures << " shard(s) failed" << std::endl;
+        return -1;
+    }
+    std::cout << "Rendered " << TOTAL_FRAMES << " frames in " << seconds << " s ("
+              << TOTAL_FRAMES / seconds << " fps, " << ranges.size() << " shards)" << std::endl;
 
-    glfwTerminate();
+    std::unique_ptr<FrameSink> sink = createSink(options, false);
+    if (sink)
+        printOutputHint(options, *sink);
     return 0;
 }